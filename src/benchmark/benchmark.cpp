@@ -0,0 +1,320 @@
+/*
+ * File:   benchmark.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 2:10 PM
+ */
+#include "../deferredThreadScheduler.h"
+#include "../deferredThreadSchedulerPool.h"
+#include <algorithm>
+#include <random>
+#include <string>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+using namespace std::chrono_literals;
+using namespace DTS;
+
+using benchmarkClock = std::chrono::steady_clock;
+
+double
+nsPerOp(const benchmarkClock::duration d, const std::size_t n) noexcept
+{
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()) /
+         static_cast<double>(n);
+}
+
+void
+report(const std::string& what, const benchmarkClock::duration d, const std::size_t n) noexcept
+{
+  std::cout << "  " << what << ": "
+            << nsPerOp(d, n) << " ns/op"
+            << " (" << n << " ops)\n";
+}
+
+// schedule n timers spread over the next hour in a timer service using queue,
+// then cancel all of them
+void
+benchmarkTimerQueue(const std::string& name,
+                    std::unique_ptr<timerQueue>&& queue,
+                    const std::size_t n) noexcept(false)
+{
+  std::mt19937_64 rng {42};
+  std::uniform_int_distribution<std::int64_t> delayMs {1'000, 3'600'000};
+  std::vector<timerService::timerId> ids {};
+  timerService ts {std::move(queue)};
+
+  std::cout << name << " with " << n << " pending timers\n";
+  ids.reserve(n);
+
+  auto now = timerClock::now();
+  auto start = benchmarkClock::now();
+  for (std::size_t i {}; i < n; ++i)
+  {
+    ids.push_back(ts.schedule(now + std::chrono::milliseconds(delayMs(rng)), [] () {}));
+  }
+  report("schedule", benchmarkClock::now() - start, n);
+
+  std::shuffle(ids.begin(), ids.end(), rng);
+  start = benchmarkClock::now();
+  for (auto id : ids)
+  {
+    ts.cancel(id);
+  }
+  report("cancel", benchmarkClock::now() - start, n);
+}
+
+// schedule n tasks an hour from now, one by one or in a batch, then cancel
+// all of them: with no timer service each task waits on the condition
+// variable of a thread of its own
+void
+benchmarkDeferredTasks(const std::string& name,
+                       timerService* ts,
+                       const std::size_t n,
+                       const bool batch = false) noexcept(false)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsUniquePtr = std::unique_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  std::vector<dtsUniquePtr> v {};
+
+  std::cout << name << " with " << n << " pending tasks\n";
+  v.reserve(n);
+  for (std::size_t i {}; i < n; ++i)
+  {
+    v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("intFoo"));
+    v.back()->registerThread([]() noexcept(false) -> threadResultType { return 1; });
+    if ( nullptr != ts )
+    {
+      v.back()->useTimerService(*ts);
+    }
+  }
+
+  auto start = benchmarkClock::now();
+  if ( batch )
+  {
+    deferredThreadScheduler<threadResultType, threadFun>::runAllIn(v, 1h);
+    report("runAllIn", benchmarkClock::now() - start, n);
+  }
+  else
+  {
+    for (auto& dts : v)
+    {
+      dts->runIn(std::chrono::seconds(1h));
+    }
+    report("runIn", benchmarkClock::now() - start, n);
+  }
+
+  start = benchmarkClock::now();
+  for (auto& dts : v)
+  {
+    dts->cancelThread();
+  }
+  for (auto& dts : v)
+  {
+    dts->wait();
+  }
+  report("cancelThread and wait", benchmarkClock::now() - start, n);
+}
+
+// create, register and destroy n instances, from the heap or recycled by a
+// pool
+void
+benchmarkFactories(const std::size_t n) noexcept(false)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  deferredThreadSchedulerPool<threadResultType, threadFun> pool {};
+
+  std::cout << "instances created and destroyed " << n << " times\n";
+
+  auto start = benchmarkClock::now();
+  for (std::size_t i {}; i < n; ++i)
+  {
+    auto dts = makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("intFoo");
+    dts->registerThread([]() noexcept(false) -> threadResultType { return 1; });
+  }
+  report("makeUniqueDeferredThreadScheduler", benchmarkClock::now() - start, n);
+
+  start = benchmarkClock::now();
+  for (std::size_t i {}; i < n; ++i)
+  {
+    auto h = pool.acquire("intFoo");
+    h->registerThread([]() noexcept(false) -> threadResultType { return 1; });
+    pool.release(h);
+  }
+  report("deferredThreadSchedulerPool", benchmarkClock::now() - start, n);
+}
+
+// fire n timers a millisecond apart and report how late the timer thread
+// collected them
+void
+benchmarkLateness(const std::size_t n) noexcept(false)
+{
+  workerPool wp {1};
+  timerService ts {std::make_unique<dAryHeapTimerQueue>(), wp};
+  std::vector<timerService::timerRequest> requests {};
+
+  std::cout << "firing lateness of the " << timerService::backendName()
+            << " backend for " << n << " timers\n";
+
+  auto start = timerClock::now() + 10ms;
+  for (std::size_t i {}; i < n; ++i)
+  {
+    requests.push_back({start + std::chrono::milliseconds(i), [] () {}, nullptr});
+  }
+  ts.schedule(std::move(requests));
+  while ( ts.pendingTimers() > 0 )
+  {
+    std::this_thread::sleep_for(10ms);
+  }
+
+  auto stats = ts.firingLateness();
+  std::cout << "  mean: " << stats.mean.count() << " ns"
+            << ", max: " << stats.max.count() << " ns"
+            << " (" << stats.firedTimers << " timers)\n";
+}
+
+// start n tasks one after the other a few milliseconds from now and report
+// the percentiles of their start lateness, sleeping on the clock or in
+// precision mode
+void
+benchmarkStartLatency(const std::string& name,
+                      const std::chrono::nanoseconds spinMargin,
+                      const std::size_t n) noexcept(false)
+{
+  using threadResultType = timerClock::time_point;
+  using threadFun = std::function<threadResultType()>;
+  std::vector<std::chrono::nanoseconds> lateness {};
+
+  lateness.reserve(n);
+  for (std::size_t i {}; i < n; ++i)
+  {
+    deferredThreadScheduler<threadResultType, threadFun> dts {"now"};
+    auto deadline = timerClock::now() + 2ms;
+
+    dts.registerThread([]() noexcept(false) -> threadResultType
+                       {
+                         return timerClock::now();
+                       }).usePrecisionMode(spinMargin).runAt(deadline);
+    auto [threadState, threadResult] = dts.wait();
+    lateness.push_back(threadResult - deadline);
+  }
+  std::sort(lateness.begin(), lateness.end());
+
+  auto percentile = [&lateness] (const double p)
+                    {
+                      return lateness[static_cast<std::size_t>(p * static_cast<double>(lateness.size() - 1))].count();
+                    };
+  std::cout << name << " start lateness for " << n << " tasks\n"
+            << "  p50: " << percentile(0.5) << " ns"
+            << ", p90: " << percentile(0.9) << " ns"
+            << ", p99: " << percentile(0.99) << " ns"
+            << ", max: " << lateness.back().count() << " ns\n";
+}
+
+// run n short tasks on an executor of type E with 1 up to all the cores as
+// workers: posted by an outside thread, as the timer thread does, and
+// posted by the tasks themselves as follow-ups
+template <typename E>
+void
+benchmarkExecutor(const std::string& name, const std::size_t n) noexcept(false)
+{
+  auto cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> numWorkers {};
+
+  for (auto workers {1u}; workers < cores; workers *= 2)
+  {
+    numWorkers.push_back(workers);
+  }
+  numWorkers.push_back(cores);
+
+  std::cout << name << ": " << n << " short tasks\n";
+  for (auto workers : numWorkers)
+  {
+    std::atomic<std::size_t> runs {0};
+
+    auto start = benchmarkClock::now();
+    {
+      E ex {workers};
+      for (std::size_t i {}; i < n; ++i)
+      {
+        ex.post([&runs] () { runs.fetch_add(1, std::memory_order_relaxed); });
+      }
+      // the dtor returns when all the tasks have run
+    }
+    report(std::to_string(workers) + " workers, posted from outside", benchmarkClock::now() - start, n);
+
+    // a chain of follow-ups per worker, each task posting the next one
+    E* pool {nullptr};
+    std::function<void(std::size_t)> spawn = [&pool, &spawn] (std::size_t left)
+                                             {
+                                               if ( left > 0 )
+                                               {
+                                                 pool->post([&spawn, left] () { spawn(left - 1); });
+                                               }
+                                             };
+    start = benchmarkClock::now();
+    {
+      E ex {workers};
+      pool = &ex;
+      for (auto w {0u}; w < workers; ++w)
+      {
+        ex.post([&spawn, n, workers] () { spawn(n / workers); });
+      }
+    }
+    report(std::to_string(workers) + " workers, posted by the tasks", benchmarkClock::now() - start, n);
+  }
+}
+}  // namespace
+
+auto main(int argc, char** argv) -> int
+{
+  std::size_t numTimers {1'000'000};
+  std::size_t numTasks {10'000};
+
+  if ( argc > 1 )
+  {
+    numTimers = std::stoul(argv[1]);
+  }
+  if ( argc > 2 )
+  {
+    numTasks = std::stoul(argv[2]);
+  }
+
+  std::cout << "\n[" << __func__ << "] "
+            << "Deferred Thread Scheduler Benchmark STARTED\n";
+
+  benchmarkTimerQueue("orderedTimerQueue",
+                      std::make_unique<orderedTimerQueue>(),
+                      numTimers);
+  benchmarkTimerQueue("dAryHeapTimerQueue",
+                      std::make_unique<dAryHeapTimerQueue>(),
+                      numTimers);
+  benchmarkTimerQueue("timingWheelTimerQueue (1ms tick)",
+                      std::make_unique<timingWheelTimerQueue>(1ms),
+                      numTimers);
+
+  timerService wheel {std::make_unique<timingWheelTimerQueue>(1ms)};
+  benchmarkDeferredTasks("thread per task", nullptr, numTasks);
+  benchmarkDeferredTasks("timingWheelTimerQueue timer service", &wheel, numTasks);
+  benchmarkDeferredTasks("timingWheelTimerQueue timer service", &wheel, numTasks, true);
+
+  benchmarkFactories(numTasks * 10);
+  benchmarkExecutor<workerPool>("workerPool", numTasks * 100);
+  benchmarkExecutor<workStealingPool>("workStealingPool", numTasks * 100);
+  benchmarkLateness(1'000);
+  benchmarkStartLatency("sleeping", 0ns, 500);
+  benchmarkStartLatency("precision mode (200us margin)", 200us, 500);
+
+  std::cout << "[" << __func__ << "] "
+            << "Deferred Thread Scheduler Benchmark COMPLETED\n";
+  return 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
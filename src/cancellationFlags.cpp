@@ -0,0 +1,114 @@
+/*
+ * File:   cancellationFlags.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 11:40 AM
+ */
+#include "cancellationFlags.h"
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <new>
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+bool
+cancellationFlagsRegistry::set(const uniqueKey& uk) noexcept
+{
+  auto& s = shardOf(uk);
+  std::unique_lock<std::shared_mutex> lk(s.mx);
+
+  try
+  {
+    if ( auto& flag = s.flags[uk];
+         false == flag )
+    {
+      // counted before the flag is visible, so that get() never skips the
+      // lookup of a flag already set
+      flagsSet_.fetch_add(1, std::memory_order_release);
+      flag = true;
+    }
+  }
+  catch (const std::bad_alloc& e)
+  {
+    // nothing was inserted
+    std::cerr << "[" << __func__ << "] "
+              << "cancellation flag not set: "
+              << e.what()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+cflag
+cancellationFlagsRegistry::get(const uniqueKey& uk) const noexcept
+{
+  if ( 0 == flagsSet_.load(std::memory_order_acquire) )
+  {
+    return false;
+  }
+
+  auto& s = shardOf(uk);
+  std::shared_lock<std::shared_mutex> lk(s.mx);
+
+  if ( auto it = s.flags.find(uk);
+       s.flags.end() != it )
+  {
+    return it->second;
+  }
+  return false;
+}
+
+std::size_t
+cancellationFlagsRegistry::erase(const uniqueKey& uk) noexcept
+{
+  auto& s = shardOf(uk);
+  std::unique_lock<std::shared_mutex> lk(s.mx);
+
+  auto it = s.flags.find(uk);
+  if ( s.flags.end() == it )
+  {
+    return 0;
+  }
+  if ( it->second )
+  {
+    flagsSet_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  s.flags.erase(it);
+  return 1;
+}
+
+std::vector<std::pair<uniqueKey, cflag>>
+cancellationFlagsRegistry::snapshot() const noexcept(false)
+{
+  std::vector<std::shared_lock<std::shared_mutex>> locks {};
+  std::vector<std::pair<uniqueKey, cflag>> flags {};
+
+  // the shards are always locked in the same order
+  locks.reserve(numShards);
+  for (auto& s : shards_)
+  {
+    locks.emplace_back(s.mx);
+  }
+  for (auto& s : shards_)
+  {
+    flags.insert(flags.end(), s.flags.begin(), s.flags.end());
+  }
+  std::sort(flags.begin(), flags.end());
+  return flags;
+}
+
+std::size_t
+cancellationFlagsRegistry::shardsInUse() const noexcept
+{
+  std::size_t inUse {0};
+
+  for (auto& s : shards_)
+  {
+    std::shared_lock<std::shared_mutex> lk(s.mx);
+    inUse += s.flags.empty() ? 0 : 1;
+  }
+  return inUse;
+}
+}  // namespace DTS
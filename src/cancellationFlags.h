@@ -0,0 +1,172 @@
+/*
+ * File:   cancellationFlags.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 11:40 AM
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+using uniqueKey = std::thread::id;
+using cflag = bool;
+
+// The cancellation request of a single deferred task, in the spirit of
+// std::stop_token: checking it is a relaxed atomic load touching no shared
+// lock. While the task runs, the token is also reachable from its thread.
+class stopToken final
+{
+ public:
+  // set the token of the task run by the calling thread for the lifetime of
+  // the scope object
+  class scope final
+  {
+   public:
+    scope(const scope& rhs) = delete;
+    scope& operator=(const scope& rhs) = delete;
+    scope(scope&& rhs) = delete;
+    scope& operator=(scope&& rhs) = delete;
+
+    explicit
+    scope(const stopToken& st) noexcept
+    :
+    previous_ (current_)
+    {
+      current_ = &st;
+    }
+
+    ~scope() noexcept
+    {
+      current_ = previous_;
+    }
+
+   private:
+    const stopToken* previous_ {nullptr};
+  };  // class scope
+
+  stopToken() = default;
+  stopToken(const stopToken& rhs) = delete;
+  stopToken& operator=(const stopToken& rhs) = delete;
+  stopToken(stopToken&& rhs) = delete;
+  stopToken& operator=(stopToken&& rhs) = delete;
+
+  // the token of the task run by the calling thread; nullptr if the calling
+  // thread is not running a deferred task
+  static
+  const stopToken*
+  current() noexcept
+  {
+    return current_;
+  }
+
+  bool
+  stopRequested() const noexcept
+  {
+    return stop_.load(std::memory_order_relaxed);
+  }
+
+  void
+  requestStop() const noexcept
+  {
+    stop_.store(true, std::memory_order_relaxed);
+  }
+
+  // make the token usable again by a task scheduled anew after it ended
+  void
+  clear() const noexcept
+  {
+    stop_.store(false, std::memory_order_relaxed);
+  }
+
+ private:
+  mutable std::atomic<bool> stop_ {false};
+
+  static inline thread_local const stopToken* current_ {nullptr};
+};  // class stopToken
+
+// The cancellation flags of the running threads, hashed on their keys into
+// shards each guarded by its own reader-writer lock, so that threads polling
+// their flags do not contend on a single lock.
+// As long as no flag is set, which is the common case, a poll is just an
+// atomic load of the number of flags set.
+class cancellationFlagsRegistry final
+{
+ public:
+  static constexpr std::size_t shardBits {6};
+  static constexpr std::size_t numShards {std::size_t {1} << shardBits};
+
+  cancellationFlagsRegistry() = default;
+  cancellationFlagsRegistry(const cancellationFlagsRegistry& rhs) = delete;
+  cancellationFlagsRegistry& operator=(const cancellationFlagsRegistry& rhs) = delete;
+  cancellationFlagsRegistry(cancellationFlagsRegistry&& rhs) = delete;
+  cancellationFlagsRegistry& operator=(cancellationFlagsRegistry&& rhs) = delete;
+
+  // false if the entry of uk cannot be allocated: its flag is not set
+  bool
+  set(const uniqueKey& uk) noexcept;
+
+  // false if there is no flag for uk; no entry is inserted
+  cflag
+  get(const uniqueKey& uk) const noexcept;
+
+  std::size_t
+  erase(const uniqueKey& uk) noexcept;
+
+  // a consistent snapshot of all the flags, ordered by key: all the shards are
+  // locked while copying
+  std::vector<std::pair<uniqueKey, cflag>>
+  snapshot() const noexcept(false);
+
+  // the shards holding at least one flag
+  std::size_t
+  shardsInUse() const noexcept;
+
+  // the shard of a key hashed to h: the hash of a thread id is often its
+  // pthread_t, an aligned address whose low bits are all zero, so it is mixed
+  // by a Fibonacci multiplication and its high bits are taken
+  static
+  std::size_t
+  shardIndex(const std::size_t h) noexcept
+  {
+    return static_cast<std::size_t>((static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ull) >> (64 - shardBits));
+  }
+
+ private:
+  struct alignas(64) shard
+  {
+    mutable std::shared_mutex mx {};
+    std::unordered_map<uniqueKey, cflag> flags {};
+  };
+
+  std::array<shard, numShards> shards_ {};
+  std::atomic<std::size_t> flagsSet_ {0};
+
+  shard&
+  shardOf(const uniqueKey& uk) noexcept
+  {
+    return shards_[shardIndex(std::hash<uniqueKey>{}(uk))];
+  }
+  const shard&
+  shardOf(const uniqueKey& uk) const noexcept
+  {
+    return shards_[shardIndex(std::hash<uniqueKey>{}(uk))];
+  }
+};  // class cancellationFlagsRegistry
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
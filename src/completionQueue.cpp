@@ -0,0 +1,154 @@
+/*
+ * File:   completionQueue.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 9:30 PM
+ */
+#include "completionQueue.h"
+#include <algorithm>
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+completionQueue::~completionQueue() noexcept
+{
+  for (auto n = head_.load(); nullptr != n;)
+  {
+    auto next = n->next;
+    release(n);
+    n = next;
+  }
+}
+
+void
+completionQueue::push(const completion& c) noexcept(false)
+{
+  auto n = new node {c, nullptr, true};
+
+  link(n);
+}
+
+void
+completionQueue::push(node& n, const completion& c) noexcept(false)
+{
+  // pairs with the release by the consumer: its reads of the node are done
+  if ( n.queued.exchange(true, std::memory_order_acquire) )
+  {
+    push(c);
+    return;
+  }
+  n.c = c;
+  link(&n);
+}
+
+void
+completionQueue::link(node* n) noexcept
+{
+  n->next = head_.load(std::memory_order_relaxed);
+  while ( false == head_.compare_exchange_weak(n->next,
+                                              n,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed) )
+  {}
+  if ( nullptr == n->next )
+  {
+    // the queue was empty: the consumer may be waiting; taking the lock makes
+    // sure the notification does not fall between its check and its wait
+    {
+      std::lock_guard<std::mutex> lg(mx_);
+    }
+    cv_.notify_one();
+  }
+}
+
+std::size_t
+completionQueue::drain(std::vector<completion>& batch) noexcept(false)
+{
+  auto n = head_.exchange(nullptr, std::memory_order_acquire);
+  auto first = batch.size();
+
+  if ( nullptr == n )
+  {
+    return 0;
+  }
+  // make room first, so that no push_back below throws with the rest of the
+  // list detached
+  {
+    std::size_t count {1};
+    auto last = n;
+
+    for (; nullptr != last->next; last = last->next)
+    {
+      ++count;
+    }
+    try
+    {
+      batch.reserve(first + count);
+    }
+    catch (...)
+    {
+      // put the list back behind the completions pushed meanwhile, which
+      // are more recent
+      for (;;)
+      {
+        if ( auto newer = head_.exchange(nullptr, std::memory_order_acquire);
+             nullptr != newer )
+        {
+          auto tail = newer;
+
+          for (; nullptr != tail->next; tail = tail->next)
+          {}
+          tail->next = n;
+          n = newer;
+        }
+        if ( node* none {nullptr};
+             head_.compare_exchange_strong(none,
+                                           n,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed) )
+        {
+          break;
+        }
+      }
+      throw;
+    }
+  }
+  for (; nullptr != n;)
+  {
+    auto next = n->next;
+    batch.push_back(n->c);
+    release(n);
+    n = next;
+  }
+  // the list has the last completion pushed first
+  std::reverse(batch.begin() + static_cast<std::ptrdiff_t>(first), batch.end());
+  return batch.size() - first;
+}
+
+std::size_t
+completionQueue::waitAndDrain(std::vector<completion>& batch,
+                              const std::chrono::nanoseconds timeout) noexcept(false)
+{
+  {
+    std::unique_lock<std::mutex> lk(mx_);
+    cv_.wait_for(lk, timeout, [this] () { return nullptr != head_.load(); });
+  }
+  return drain(batch);
+}
+
+bool
+completionQueue::empty() const noexcept
+{
+  return nullptr == head_.load();
+}
+
+void
+completionQueue::release(node* n) noexcept
+{
+  if ( n->allocated )
+  {
+    delete n;
+    return;
+  }
+  n->queued.store(false, std::memory_order_release);
+}
+}  // namespace DTS
@@ -0,0 +1,104 @@
+/*
+ * File:   completionQueue.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 9:30 PM
+ */
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+class deferredThreadSchedulerBase;
+
+// The completions of the deferred tasks using it, pushed by the threads
+// terminating the tasks and drained in batches by a single consumer thread.
+// Pushing is lock-free: a completion is linked at the head of a list with a
+// compare-and-swap. The consumer takes the whole list with a single exchange,
+// so draining a batch costs one atomic operation whatever its size. Only a
+// push to an empty queue takes the lock, to wake up a consumer waiting.
+// Every deferred task embeds a node of its own, linked with no allocation
+// unless the previous completion of the task is still queued.
+class completionQueue final
+{
+ public:
+  struct completion
+  {
+    // the instance terminated, which must outlive the completion
+    const deferredThreadSchedulerBase* dts {nullptr};
+    // Run, Canceled or ExceptionThrown
+    int state {};
+  };
+
+  // a completion linked in the queue, embedded in its pusher or allocated by
+  // the queue
+  struct node
+  {
+    completion c {};
+    node* next {nullptr};
+    // deleted once drained, else only marked as no longer queued
+    bool allocated {false};
+    std::atomic<bool> queued {false};
+  };
+
+  completionQueue() = default;
+  completionQueue(const completionQueue& rhs) = delete;
+  completionQueue& operator=(const completionQueue& rhs) = delete;
+  completionQueue(completionQueue&& rhs) = delete;
+  completionQueue& operator=(completionQueue&& rhs) = delete;
+
+  // the completions not drained are dropped
+  ~completionQueue() noexcept;
+
+  // called by any thread
+  void
+  push(const completion& c) noexcept(false);
+
+  // as above, linking n, which must outlive its completion in the queue, if
+  // it is not queued already
+  void
+  push(node& n, const completion& c) noexcept(false);
+
+  // called by the consumer thread only: append the completions pushed so far
+  // to batch, in the order they were pushed, and return how many; if batch
+  // cannot grow, the completions are left in the queue
+  std::size_t
+  drain(std::vector<completion>& batch) noexcept(false);
+
+  // as drain(), first waiting up to timeout for a completion to be pushed
+  std::size_t
+  waitAndDrain(std::vector<completion>& batch,
+               const std::chrono::nanoseconds timeout) noexcept(false);
+
+  bool
+  empty() const noexcept;
+
+ private:
+  // the completions pushed, the last one first
+  std::atomic<node*> head_ {nullptr};
+
+  mutable std::mutex mx_ {};
+  std::condition_variable cv_ {};
+
+  void
+  link(node* n) noexcept;
+
+  // a node drained or dropped
+  static
+  void
+  release(node* n) noexcept;
+};  // class completionQueue
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
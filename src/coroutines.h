@@ -0,0 +1,124 @@
+/*
+ * File:   coroutines.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 10:40 PM
+ */
+#pragma once
+
+#include "deferredThreadScheduler.h"
+////////////////////////////////////////////////////////////////////////////////
+// the awaitables need C++20 coroutines: with an older standard this header
+// declares nothing
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+// co_await on a scheduled instance suspends the coroutine until the task
+// terminates, whether it runs, is canceled or throws, then resumes it on the
+// executor of the instance with the threadResult of wait(); no thread blocks
+// meanwhile, the suspended frame is all that is kept.
+// An instance that is not pending resumes the coroutine at once
+template <typename RT, typename F>
+class taskAwaiter final
+{
+ public:
+  explicit
+  taskAwaiter(const deferredThreadScheduler<RT, F>& dts) noexcept
+  :
+  dts_ (dts)
+  {}
+
+  bool
+  await_ready() const noexcept
+  {
+    return (false == dts_.isScheduled()) && (false == dts_.isRunning());
+  }
+
+  bool
+  await_suspend(std::coroutine_handle<> h) const noexcept(false)
+  {
+    // the coroutine may be resumed by another thread before this returns
+    return dts_.postOnCompletion([h] () { h.resume(); });
+  }
+
+  // the task has terminated, though its continuation may still be running
+  // and its future may not be ready yet: the result is read without waiting
+  typename deferredThreadScheduler<RT, F>::threadResult
+  await_resume() const noexcept(false)
+  {
+    return dts_.terminatedResult_();
+  }
+
+ private:
+  const deferredThreadScheduler<RT, F>& dts_;
+};  // class taskAwaiter
+
+// co_await dts.runIn(200ms) schedules the task and suspends until it
+// terminates
+template <typename RT, typename F>
+taskAwaiter<RT, F>
+operator co_await(const deferredThreadScheduler<RT, F>& dts) noexcept
+{
+  return taskAwaiter<RT, F> {dts};
+}
+
+// suspends the coroutine until deadline in the timer queue of a timer
+// service, occupying no thread, then resumes it on the executor of the timer
+// service; a coroutine parked in a timer service destroyed before the
+// deadline is never resumed
+class sleepAwaiter final
+{
+ public:
+  sleepAwaiter(const timerDeadline deadline, timerService& ts) noexcept
+  :
+  deadline_ (deadline),
+  timerService_ (ts)
+  {}
+
+  bool
+  await_ready() const noexcept
+  {
+    return deadline_ <= timerClock::now();
+  }
+
+  void
+  await_suspend(std::coroutine_handle<> h) const noexcept(false)
+  {
+    timerService_.schedule(deadline_, [h] () { h.resume(); });
+  }
+
+  void
+  await_resume() const noexcept
+  {}
+
+ private:
+  timerDeadline deadline_;
+  timerService& timerService_;
+};  // class sleepAwaiter
+
+inline
+sleepAwaiter
+sleep_until(const timerDeadline deadline,
+            timerService& ts = timerService::defaultTimerService()) noexcept
+{
+  return sleepAwaiter {deadline, ts};
+}
+
+inline
+sleepAwaiter
+sleep_for(const std::chrono::nanoseconds d,
+          timerService& ts = timerService::defaultTimerService()) noexcept
+{
+  return sleepAwaiter {timerClock::now() + d, ts};
+}
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
+#endif
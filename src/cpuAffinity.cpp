@@ -0,0 +1,63 @@
+/*
+ * File:   cpuAffinity.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 11:55 PM
+ */
+#include "cpuAffinity.h"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+namespace
+{
+#if defined(__linux__)
+bool
+pin(const pthread_t t, const cpuSet& cpus) noexcept
+{
+  if ( cpus.empty() )
+  {
+    return false;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+  {
+    if ( cpu >= CPU_SETSIZE )
+    {
+      return false;
+    }
+    CPU_SET(cpu, &set);
+  }
+  return 0 == pthread_setaffinity_np(t, sizeof(set), &set);
+}
+#endif
+}  // namespace
+
+bool
+pinThisThread(const cpuSet& cpus) noexcept
+{
+#if defined(__linux__)
+  return pin(pthread_self(), cpus);
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif
+}
+
+bool
+pinThread(std::thread& t, const cpuSet& cpus) noexcept
+{
+#if defined(__linux__)
+  return t.joinable() && pin(t.native_handle(), cpus);
+#else
+  static_cast<void>(t);
+  static_cast<void>(cpus);
+  return false;
+#endif
+}
+}  // namespace DTS
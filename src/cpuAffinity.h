@@ -0,0 +1,27 @@
+/*
+ * File:   cpuAffinity.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 11:55 PM
+ */
+#pragma once
+
+#include <vector>
+#include <thread>
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+// the CPUs a thread may run on, by their index as the OS numbers them
+using cpuSet = std::vector<unsigned int>;
+
+// pin the calling thread to cpus with pthread_setaffinity_np; false if cpus
+// is empty or not valid, or on systems other than Linux.
+// Memory is placed by the OS on the NUMA node of the CPU that first touches
+// it: what a pinned thread allocates and initializes lands on its node
+bool
+pinThisThread(const cpuSet& cpus) noexcept;
+
+// as pinThisThread(), for the running thread t
+bool
+pinThread(std::thread& t, const cpuSet& cpus) noexcept;
+}  // namespace DTS
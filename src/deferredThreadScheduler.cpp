@@ -5,10 +5,13 @@
  * Created on November 16, 2017, 10:43 AM
  */
 #include "deferredThreadScheduler.h"
+#include <algorithm>
 ////////////////////////////////////////////////////////////////////////////////
 namespace DTS
 {
 cflags deferredThreadSchedulerBase::cancellationFlags_ {};
+std::atomic<unsigned int> deferredThreadSchedulerBase::spinningThreads_ {0};
+std::atomic<unsigned int> deferredThreadSchedulerBase::maxSpinningThreads_ {std::max(1u, std::thread::hardware_concurrency() / 2)};
 
 std::string&
 deferredThreadSchedulerBase::deferredThreadSchedulerVersion () noexcept
@@ -35,19 +38,57 @@ deferredThreadSchedulerBase::getThreadName() const noexcept
 bool
 deferredThreadSchedulerBase::cancelThread() const noexcept
 {
+  auto ts_ = getThreadState_();
+  auto stopRequested {false};
+  for (;;)
   {
-    std::unique_lock<std::mutex> lk(cv_mx_);
-    if ( auto ts_ = getThreadState_();
-         (threadState::NotValid != ts_) &&
-         (threadState::Registered != ts_) &&
-         (threadState::Scheduled != ts_) )
+    if ( (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) ||
+         (threadState::Scheduled == ts_) )
     {
-      // thread cannot be canceled when not possible
-      return false;
+      if ( threadState_.compare_exchange_weak(ts_, threadState::Canceled) )
+      {
+        break;
+      }
+      // on failure ts_ is reloaded with the state set by the firing thread
+      continue;
+    }
+    // a running periodic task is stopped when its run ends, without
+    // scheduling it again
+    if ( (threadState::Running == ts_) && periodic_.load() )
+    {
+      stopToken_.requestStop();
+      stopRequested = true;
+      // pairs with the fence of the firing thread once it moved back to
+      // Scheduled: either it sees the stop, or this sees Scheduled and
+      // cancels the next period
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      ts_ = getThreadState_();
+      if ( threadState::Running == ts_ )
+      {
+        return true;
+      }
+      continue;
     }
-    setThreadState(threadState::Canceled);
+    // canceled by the firing thread on the stop requested here, else the
+    // thread cannot be canceled when not possible
+    return stopRequested && (threadState::Canceled == ts_);
+  }
+  {
+    // the waiting thread checks the state holding the lock: take it so that
+    // the notification cannot fall between its check and its wait; with a
+    // timer service, it is a fired job waiting the margin of precision mode
+    std::lock_guard<std::mutex> lg(cv_mx_);
   }
-  cv_.notify_one();
+  cv_.notify_all();
+  if ( nullptr != timerService_ )
+  {
+    // a canceled task must not keep its entry in the timer queue until the
+    // deferred time expires; if the id is not stored yet, storeTimerId_()
+    // removes the entry instead
+    timerService_->cancel(timerId_.load());
+  }
+  completed(threadState::Canceled);
   return true;
 }
 
@@ -57,6 +98,15 @@ deferredThreadSchedulerBase::setThreadId() const noexcept
   threadId_.store(std::this_thread::get_id());
 }
 
+void
+deferredThreadSchedulerBase::pinOwnThread() const noexcept
+{
+  if ( false == affinity_.empty() )
+  {
+    pinThisThread(affinity_);
+  }
+}
+
 std::thread::id
 deferredThreadSchedulerBase::getThreadId() const noexcept
 {
@@ -75,25 +125,351 @@ deferredThreadSchedulerBase::setExceptionThrownMessage(const std::string& s) con
   exceptionThrownMessage_ = s;
 }
 
+void
+deferredThreadSchedulerBase::completed(const threadState ts) const noexcept
+{
+  std::vector<executorTask> jobs {};
+  {
+    // signal holding the lock, so that a waiter cannot detach and return
+    // while its latch is in use here
+    std::lock_guard<std::mutex> lg(cv_mx_);
+    for (auto& [l, index] : latches_)
+    {
+      std::lock_guard<std::mutex> llg(l->mx);
+      l->done.push_back(index);
+      l->cv.notify_one();
+    }
+    latches_.clear();
+    jobs.swap(completionJobs_);
+  }
+  // posted, not run here: a job must not find the task still terminating
+  // on the calling thread
+  for (auto& job : jobs)
+  {
+    try
+    {
+      auto& ex {(nullptr != executor_) ? *executor_ :
+                (nullptr != timerService_) ? timerService_->getExecutor() :
+                timerService::defaultTimerService().getExecutor()};
+      ex.post(std::move(job));
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "[" << __func__ << "] "
+                << "completion job not posted: "
+                << e.what()
+                << std::endl;
+    }
+  }
+  if ( nullptr == completionQueue_ )
+  {
+    return;
+  }
+  try
+  {
+    completionQueue_->push(completionNode_, {this, static_cast<baseThreadStateType>(ts)});
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "[" << __func__ << "] "
+              << "completion not pushed: "
+              << e.what()
+              << std::endl;
+  }
+}
+
+bool
+deferredThreadSchedulerBase::attachLatch(completionLatch& l, const std::size_t index) const noexcept(false)
+{
+  std::lock_guard<std::mutex> lg(cv_mx_);
+
+  // the terminal state is set before completed() takes the lock: a task
+  // still pending here signals l later
+  if ( auto ts_ {getThreadState_()};
+       (threadState::Scheduled != ts_) &&
+       (threadState::Running != ts_) )
+  {
+    return false;
+  }
+  latches_.emplace_back(&l, index);
+  return true;
+}
+
+bool
+deferredThreadSchedulerBase::postOnCompletion(executorTask&& job) const noexcept(false)
+{
+  if ( false == static_cast<bool>(job) )
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lg(cv_mx_);
+
+  if ( auto ts_ {getThreadState_()};
+       (threadState::Scheduled != ts_) &&
+       (threadState::Running != ts_) )
+  {
+    return false;
+  }
+  completionJobs_.push_back(std::move(job));
+  return true;
+}
+
+void
+deferredThreadSchedulerBase::detachLatch(const completionLatch& l) const noexcept
+{
+  std::lock_guard<std::mutex> lg(cv_mx_);
+
+  latches_.erase(std::remove_if(latches_.begin(),
+                                latches_.end(),
+                                [&l] (const auto& e) { return &l == e.first; }),
+                 latches_.end());
+}
+
+std::vector<std::size_t>
+deferredThreadSchedulerBase::waitFor_(const std::vector<const deferredThreadSchedulerBase*>& dtss,
+                                      const std::size_t count,
+                                      const std::optional<timerDeadline> deadline) noexcept(false)
+{
+  std::vector<std::size_t> ready {};
+  std::vector<std::size_t> attached {};
+  completionLatch l {};
+
+  auto isPending = [] (const deferredThreadSchedulerBase* dts)
+                   {
+                     auto ts_ {dts->getThreadState_()};
+                     return (threadState::Scheduled == ts_) || (threadState::Running == ts_);
+                   };
+
+  // no latch is needed if enough instances have already terminated
+  for (std::size_t i {}; i < dtss.size(); ++i)
+  {
+    if ( false == isPending(dtss[i]) )
+    {
+      ready.push_back(i);
+    }
+  }
+  if ( (ready.size() >= count) || (ready.size() == dtss.size()) )
+  {
+    return ready;
+  }
+
+  ready.clear();
+  for (std::size_t i {}; i < dtss.size(); ++i)
+  {
+    if ( dtss[i]->attachLatch(l, i) )
+    {
+      attached.push_back(i);
+    }
+    else
+    {
+      ready.push_back(i);
+    }
+  }
+  if ( ready.size() < count )
+  {
+    std::unique_lock<std::mutex> lk(l.mx);
+    auto enough = [&ready, &l, count] () { return ready.size() + l.done.size() >= count; };
+
+    if ( deadline.has_value() )
+    {
+      l.cv.wait_until(lk, *deadline, enough);
+    }
+    else
+    {
+      l.cv.wait(lk, enough);
+    }
+  }
+  // no instance signals l once detached
+  for (auto i : attached)
+  {
+    dtss[i]->detachLatch(l);
+  }
+  ready.insert(ready.end(), l.done.begin(), l.done.end());
+  if ( count > 1 )
+  {
+    std::sort(ready.begin(), ready.end());
+  }
+  return ready;
+}
+
 void
 deferredThreadSchedulerBase::setThreadState(const threadState& threadState) const noexcept
 {
-  std::lock_guard<std::mutex> lg(threadState_mx_);
-  threadState_ = threadState; 
+  threadState_.store(threadState);
+}
+
+bool
+deferredThreadSchedulerBase::transitionThreadState(threadState from, const threadState to) const noexcept
+{
+  return threadState_.compare_exchange_strong(from, to);
 }
 
 baseThreadStateType
 deferredThreadSchedulerBase::getThreadState() const noexcept
 {
-  std::lock_guard<std::mutex> lg(threadState_mx_);
-  return static_cast<baseThreadStateType>(threadState_);
+  return static_cast<baseThreadStateType>(threadState_.load());
+}
+
+std::uint64_t
+deferredThreadSchedulerBase::getExecutions() const noexcept
+{
+  return executions_.load();
+}
+
+std::uint64_t
+deferredThreadSchedulerBase::getMissedPeriods() const noexcept
+{
+  return missedPeriods_.load();
+}
+
+bool
+deferredThreadSchedulerBase::isPeriodic() const noexcept
+{
+  return periodic_.load();
+}
+
+executor::priority
+deferredThreadSchedulerBase::getPriority() const noexcept
+{
+  return priority_;
+}
+
+executor*
+deferredThreadSchedulerBase::taskExecutor_() const noexcept
+{
+  if ( (executor::defaultPriority == priority_) || (nullptr == timerService_) )
+  {
+    return executor_;
+  }
+  // only read here: the timer thread may still be posting the previous
+  // period of a periodic instance through it
+  return &prioritized_;
+}
+
+void
+deferredThreadSchedulerBase::storeTimerId_(const timerService::timerId id) const noexcept
+{
+  timerId_.store(id);
+  // a cancelThread() that won the transition from Scheduled before the store
+  // found no timer to remove: remove it here; the store and the load below
+  // pair with the transition and the load of the id in cancelThread(), so
+  // that at least one of the two sees the other
+  if ( threadState::Canceled == getThreadState_() )
+  {
+    timerService_->cancel(id);
+  }
+}
+
+void
+deferredThreadSchedulerBase::retargetPriority_() const noexcept
+{
+  if ( nullptr != timerService_ )
+  {
+    prioritized_.retarget((nullptr == executor_) ? timerService_->getExecutor() : *executor_,
+                          priority_);
+  }
+}
+
+void
+deferredThreadSchedulerBase::setMaxSpinningThreads(const unsigned int n) noexcept
+{
+  maxSpinningThreads_.store(n);
+}
+
+unsigned int
+deferredThreadSchedulerBase::getMaxSpinningThreads() noexcept
+{
+  return maxSpinningThreads_.load();
+}
+
+unsigned int
+deferredThreadSchedulerBase::getSpinningThreads() noexcept
+{
+  return spinningThreads_.load();
+}
+
+bool
+deferredThreadSchedulerBase::acquireSpinningThread() noexcept
+{
+  auto n = spinningThreads_.load();
+  do
+  {
+    if ( n >= maxSpinningThreads_.load() )
+    {
+      return false;
+    }
+  } while ( false == spinningThreads_.compare_exchange_weak(n, n + 1) );
+  return true;
+}
+
+timerDeadline
+deferredThreadSchedulerBase::nextPeriodDeadline(const timerDeadline deadline,
+                                                const std::chrono::nanoseconds period,
+                                                const periodicMode mode) const noexcept
+{
+  auto now = timerClock::now();
+
+  if ( periodicMode::fixedDelay == mode )
+  {
+    return now + period;
+  }
+
+  auto next = deadline + period;
+  if ( next <= now )
+  {
+    // stay on the grid: skip the periods whose deadline already passed
+    auto missed = (now - next) / period + 1;
+
+    missedPeriods_.fetch_add(static_cast<std::uint64_t>(missed));
+    next += missed * period;
+  }
+  return next;
 }
 
 deferredThreadSchedulerBase::threadState
 deferredThreadSchedulerBase::getThreadState_() const noexcept
 {
-  std::lock_guard<std::mutex> lg(threadState_mx_);
-  return threadState_;
+  return threadState_.load();
+}
+
+bool
+deferredThreadSchedulerBase::resetThreadState() const noexcept
+{
+  auto ts_ = getThreadState_();
+
+  if ( (threadState::Run != ts_) &&
+       (threadState::Canceled != ts_) &&
+       (threadState::ExceptionThrown != ts_) )
+  {
+    return false;
+  }
+  stopToken_.clear();
+  exceptionThrownMessage_.clear();
+  timerId_.store(timerService::invalidTimerId);
+  periodic_.store(false);
+  return transitionThreadState(ts_, threadState::Registered);
+}
+
+void
+deferredThreadSchedulerBase::clearThreadState(const std::string& threadName) const noexcept
+{
+  // no other thread uses the instance now: whoever hands it out next
+  // publishes these stores
+  threadName_ = threadName;
+  threadId_.store({}, std::memory_order_relaxed);
+  exceptionThrownMessage_.clear();
+  stopToken_.clear();
+  timerService_ = nullptr;
+  timerId_.store(timerService::invalidTimerId, std::memory_order_relaxed);
+  executor_ = nullptr;
+  priority_ = executor::defaultPriority;
+  completionQueue_ = nullptr;
+  periodic_.store(false, std::memory_order_relaxed);
+  executions_.store(0, std::memory_order_relaxed);
+  missedPeriods_.store(0, std::memory_order_relaxed);
+  spinMargin_ = std::chrono::nanoseconds::zero();
+  affinity_.clear();
+  threadState_.store(threadState::NotValid, std::memory_order_relaxed);
 }
 }  // namespace DTS
 ////////////////////////////////////////////////////////////////////////////////
@@ -7,17 +7,27 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <cstdint>
 #include <type_traits>
 #include <string>
+#include <stdexcept>
+#include <vector>
 #include <tuple>
-#include <map>
+#include <optional>
+#include <variant>
 #include <atomic>
 #include <mutex>
+#include <memory>
 #include <future>
 #include <thread>
 #include <condition_variable>
 #include <chrono>
 #include <ratio>
+#include "timerService.h"
+#include "inplaceTask.h"
+#include "completionQueue.h"
+#include "cancellationFlags.h"
 ////////////////////////////////////////////////////////////////////////////////
 // BEGIN: ignore the warnings listed below when compiled with clang from here
 #pragma clang diagnostic push
@@ -40,15 +50,27 @@ reallyAsync(F&& f, Ts&&... params)
                     std::forward<Ts>(params)...);
 }
 
+// a hint to the core that the thread is busy-waiting
+inline
+void
+cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#else
+  std::this_thread::yield();
+#endif
+}
+
 using deafultThreadFunctionResult = int;
 using baseThreadStateType = int;
 
 template<typename RT = deafultThreadFunctionResult, typename... Args>
 using defaulThreadFun = std::function<RT(const Args&... args)>;
 
-using uniqueKey = std::thread::id;
-using cflag = bool;
-using cflags = std::map<uniqueKey, cflag>;
+using cflags = cancellationFlagsRegistry;
 
 class deferredThreadSchedulerBase
 {
@@ -64,6 +86,16 @@ public:
     ExceptionThrown
   };
 
+  // how the deadlines of a periodic task follow each other:
+  // - fixedRate: on the grid first deadline + k * period; the periods missed
+  //   because a run overran are skipped and counted
+  // - fixedDelay: a period after the end of the previous run
+  enum class periodicMode
+  {
+    fixedRate,
+    fixedDelay
+  };
+
   static inline std::string version {"1.0.0"};
   static std::string& deferredThreadSchedulerVersion() noexcept;
 
@@ -87,6 +119,34 @@ public:
   baseThreadStateType
   getThreadState() const noexcept;
 
+  // the runs of the thread function completed so far
+  std::uint64_t
+  getExecutions() const noexcept;
+
+  // the periods of a fixed-rate periodic task skipped because a run overran
+  std::uint64_t
+  getMissedPeriods() const noexcept;
+
+  bool
+  isPeriodic() const noexcept;
+
+  executor::priority
+  getPriority() const noexcept;
+
+  // at most this many threads busy-wait the deadline of a task in precision
+  // mode at the same time; the others just wait on the clock
+  static
+  void
+  setMaxSpinningThreads(const unsigned int n) noexcept;
+
+  static
+  unsigned int
+  getMaxSpinningThreads() noexcept;
+
+  static
+  unsigned int
+  getSpinningThreads() noexcept;
+
   constexpr
   bool
   isRegistered(const baseThreadStateType s) noexcept
@@ -183,28 +243,100 @@ public:
   {
     return true == getCancellationFlag(uk);
   }
+  // called by a running task: check the stop token of the task, or the
+  // cancellation flag of the calling thread when it is not running a task
   static
   bool
   isCancellationFlagSet() noexcept
   {
+    if ( auto st {stopToken::current()};
+         nullptr != st )
+    {
+      return st->stopRequested();
+    }
     return true == getCancellationFlag(std::this_thread::get_id());
   }
 
+  const stopToken&
+  getStopToken() const noexcept
+  {
+    return stopToken_;
+  }
+
+  // post job to the executor of the instance once the task terminates, as
+  // with onCompletion() but for any number of jobs, e.g. resuming the
+  // coroutines awaiting it; false, not posting job, if job is empty or if
+  // the task is neither Scheduled nor Running
+  bool
+  postOnCompletion(executorTask&& job) const noexcept(false);
+
+  // returned by wait_any() when no instance terminates in time
+  static constexpr std::size_t noIndex {static_cast<std::size_t>(-1)};
+
+  // block until one of the instances in dtss, a range of instances or of
+  // pointers to them, is no longer Scheduled nor Running, and return its index
+  // in dtss; noIndex if none terminates within timeout.
+  // The waiter sleeps on a single latch, that each instance terminating
+  // signals once: nothing polls, and the cost follows the completions, not the
+  // number of instances times the wakeups. wait() or take() on the instance
+  // found return its result
+  template <typename Range>
+  static
+  std::size_t
+  wait_any(const Range& dtss, const std::chrono::nanoseconds timeout) noexcept(false)
+  {
+    auto done {waitFor_(instances_(dtss), 1, timerClock::now() + timeout)};
+
+    return done.empty() ? noIndex : done.front();
+  }
+  template <typename Range>
+  static
+  std::size_t
+  wait_any(const Range& dtss) noexcept(false)
+  {
+    auto done {waitFor_(instances_(dtss), 1, std::nullopt)};
+
+    return done.empty() ? noIndex : done.front();
+  }
+
+  // block until all the instances in dtss are no longer Scheduled nor
+  // Running, at most timeout, and return the indices in dtss, ascending, of
+  // those terminated: all of them unless the time-out expired
+  template <typename Range>
+  static
+  std::vector<std::size_t>
+  wait_all(const Range& dtss, const std::chrono::nanoseconds timeout) noexcept(false)
+  {
+    auto dts_ {instances_(dtss)};
+
+    return waitFor_(dts_, dts_.size(), timerClock::now() + timeout);
+  }
+  template <typename Range>
+  static
+  std::vector<std::size_t>
+  wait_all(const Range& dtss) noexcept(false)
+  {
+    auto dts_ {instances_(dtss)};
+
+    return waitFor_(dts_, dts_.size(), std::nullopt);
+  }
+
+  // throws if the snapshot of the flags cannot be allocated
   static
   auto
-  listCancellationFlags(std::ostream& os) noexcept
+  listCancellationFlags(std::ostream& os) noexcept(false)
   {
     unsigned int cancellationFlagSet {};
     unsigned int cancellationFlagUnSet {};
 
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
-    if ( 0 == getCancellationFlags_ref().size() )
+    auto flags {getCancellationFlags_ref().snapshot()};
+    if ( 0 == flags.size() )
     {
       os << "[" << __func__ << "] "
          << "Cancellation flags map is EMPTY"
          << std::endl;
     }
-    for (auto&& [uniqueKey, cancellationFlag] : getCancellationFlags_ref())
+    for (auto&& [uniqueKey, cancellationFlag] : flags)
     {
       os << "[" << __func__ << "] "
          << uniqueKey
@@ -221,16 +353,13 @@ public:
         ++cancellationFlagUnSet;
       }
     }
-    return std::make_tuple(getCancellationFlags_ref().size(),
+    return std::make_tuple(flags.size(),
                            cancellationFlagSet,
                            cancellationFlagUnSet);
   }
 
  protected:
-  // mutex associated to cancellation flags static map
-  static inline std::mutex cancellationFlagsMx_ {};
-
-  // the cancellation flags static map
+  // the cancellation flags static registry
   // it's static because it is a class attribute
   static cflags cancellationFlags_;
 
@@ -241,25 +370,182 @@ public:
   // mutex associated to the condition variable cv_
   mutable std::mutex cv_mx_ {};
 
-  // mutex associated to the thread state
-  mutable std::mutex threadState_mx_ {};
-  mutable threadState threadState_ {threadState::NotValid};
+  // the thread state changes by compare-and-swap transitions, so that queries
+  // are wait-free and cancelThread() cannot race with the firing thread
+  mutable std::atomic<threadState> threadState_ {threadState::NotValid};
   mutable std::atomic<std::thread::id> threadId_;
 
   mutable std::string exceptionThrownMessage_ {};
 
+  // set by the dtor to stop the task while it is running
+  stopToken stopToken_ {};
+
+  // the timer service whose timer thread serves this instance and the id of
+  // the pending timer; nullptr means that the instance waits the deferred time
+  // on its own thread
+  mutable timerService* timerService_ {nullptr};
+  mutable std::atomic<timerService::timerId> timerId_ {timerService::invalidTimerId};
+  // where the task is run when the timer expires; nullptr means the executor
+  // of the timer service
+  mutable executor* executor_ {nullptr};
+  // the priority the task is posted at when its timer expires, through
+  // prioritized_ unless it is the default one
+  mutable executor::priority priority_ {executor::defaultPriority};
+  mutable priorityExecutor prioritized_ {};
+  // where the termination of the task is pushed, if any, through
+  // completionNode_ unless its previous termination is still queued
+  mutable completionQueue* completionQueue_ {nullptr};
+  mutable completionQueue::node completionNode_ {};
+
+  // where wait_any() and wait_all() sleep: the instances terminating append
+  // their index to done
+  struct completionLatch
+  {
+    std::mutex mx {};
+    std::condition_variable cv {};
+    std::vector<std::size_t> done {};
+  };
+  // the latches of the waiters of this instance with its index for each, held
+  // under cv_mx_ until the task terminates
+  mutable std::vector<std::pair<completionLatch*, std::size_t>> latches_ {};
+  // posted when the task terminates, held under cv_mx_ until then
+  mutable std::vector<executorTask> completionJobs_ {};
+
+  // a periodic task goes back to Scheduled after each run, and cancelThread()
+  // stops it even while it runs
+  mutable std::atomic<bool> periodic_ {false};
+  mutable std::atomic<std::uint64_t> executions_ {0};
+  mutable std::atomic<std::uint64_t> missedPeriods_ {0};
+
+  // the CPUs the thread of an instance without a timer service is pinned
+  // to, if any
+  mutable cpuSet affinity_ {};
+
+  // in precision mode the thread sleeps until spinMargin_ before the deadline
+  // and busy-waits the rest; zero means not in precision mode
+  mutable std::chrono::nanoseconds spinMargin_ {0};
+
+  static std::atomic<unsigned int> spinningThreads_;
+  static std::atomic<unsigned int> maxSpinningThreads_;
+
   void
   setExceptionThrownMessage(const std::string& s) const noexcept;
 
+  // what the timer service posts the task to: executor_ at priority_
+  executor*
+  taskExecutor_() const noexcept;
+
+  // publish the id of the timer just armed for the task, removing the timer
+  // if the task was canceled meanwhile
+  void
+  storeTimerId_(const timerService::timerId id) const noexcept;
+
+  // point prioritized_ at the executor the task runs on, at priority_: called
+  // by the setters of the three, while no timer of the task is pending
+  void
+  retargetPriority_() const noexcept;
+
+  // called once the task has terminated in state ts, Run, Canceled or
+  // ExceptionThrown, by the thread that terminated it
+  virtual
+  void
+  completed(const threadState ts) const noexcept;
+
+  // signal l with index when the task terminates; false, not attaching l, if
+  // the task is not pending
+  bool
+  attachLatch(completionLatch& l, const std::size_t index) const noexcept(false);
+
+  void
+  detachLatch(const completionLatch& l) const noexcept;
+
+  // the indices of the instances in dtss not pending once at least count of
+  // them are, or at deadline: first those found terminated, then the others in
+  // the order they terminated
+  static
+  std::vector<std::size_t>
+  waitFor_(const std::vector<const deferredThreadSchedulerBase*>& dtss,
+           const std::size_t count,
+           const std::optional<timerDeadline> deadline) noexcept(false);
+
+  template <typename Range>
+  static
+  std::vector<const deferredThreadSchedulerBase*>
+  instances_(const Range& dtss) noexcept(false)
+  {
+    std::vector<const deferredThreadSchedulerBase*> dts_ {};
+
+    for (auto& element : dtss)
+    {
+      if constexpr ( std::is_convertible_v<decltype(element), const deferredThreadSchedulerBase&> )
+      {
+        dts_.push_back(&element);
+      }
+      else
+      {
+        dts_.push_back(&(*element));
+      }
+    }
+    return dts_;
+  }
+
   void
   setThreadState(const threadState& threadState) const noexcept;
 
+  // move to state to only if the current state is from
+  bool
+  transitionThreadState(threadState from, const threadState to) const noexcept;
+
   threadState
   getThreadState_() const noexcept;
 
+  // return a terminated task to Registered, keeping its closure and its
+  // settings; false if the task is not terminated
+  bool
+  resetThreadState() const noexcept;
+
+  // back to NotValid with the settings and counters of a new instance; the
+  // task must not be pending nor running
+  void
+  clearThreadState(const std::string& threadName) const noexcept;
+
+  // the deadline of the next run of a periodic task whose last deadline was
+  // deadline, counting the missed periods
+  timerDeadline
+  nextPeriodDeadline(const timerDeadline deadline,
+                     const std::chrono::nanoseconds period,
+                     const periodicMode mode) const noexcept;
+
   void
   setThreadId() const noexcept;
 
+  // called by the thread of an instance without a timer service: pin it to
+  // affinity_, if set
+  void
+  pinOwnThread() const noexcept;
+
+  // busy-wait until deadline, or until the task is no longer Scheduled;
+  // false, without waiting, if too many threads are already spinning
+  template <typename Clock, typename Duration>
+  bool
+  spinUntil(const std::chrono::time_point<Clock, Duration> deadline) const noexcept
+  {
+    if ( false == acquireSpinningThread() )
+    {
+      return false;
+    }
+    while ( (Clock::now() < deadline) && (threadState::Scheduled == getThreadState_()) )
+    {
+      cpuRelax();
+    }
+    spinningThreads_.fetch_sub(1);
+    return true;
+  }
+
+  static
+  bool
+  acquireSpinningThread() noexcept;
+
   static
   cflags&
   getCancellationFlags_ref() noexcept
@@ -267,215 +553,371 @@ public:
     return cancellationFlags_;
   }
 
+  // false if the flag cannot be stored
   static
-  void
+  bool
   setCancellationFlag(const uniqueKey& uk) noexcept
   {
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
-    getCancellationFlags_ref()[uk] = true;
+    return getCancellationFlags_ref().set(uk);
   }
   static
-  void
+  bool
   setCancellationFlag() noexcept
   {
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
-    getCancellationFlags_ref()[std::this_thread::get_id()] = true;
+    return getCancellationFlags_ref().set(std::this_thread::get_id());
   }
 
   static
   cflag
   getCancellationFlag(const uniqueKey& uk) noexcept
   {
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
-    return getCancellationFlags_ref()[uk];
+    return getCancellationFlags_ref().get(uk);
   }
   static
   cflag
   getCancellationFlag() noexcept
   {
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
-    return getCancellationFlags_ref()[std::this_thread::get_id()];
+    return getCancellationFlags_ref().get(std::this_thread::get_id());
   }
 
   static
   auto
   eraseCancellationFlag(const uniqueKey& uk) noexcept
   {
-    // remove the entry for this thread from the static map
-    std::unique_lock<std::mutex> lk(cancellationFlagsMx_);
+    // remove the entry for this thread from the static registry
     return getCancellationFlags_ref().erase(uk);
   }
 };  // class deferredThreadSchedulerBase
 
+// THREAD_RETURN_TYPE () so that it works for void thread functions too
 #define TERMINATE_ON_CANCELLATION(THREAD_RETURN_TYPE) \
 if ( deferredThreadSchedulerBase::isCancellationFlagSet() ) \
 { \
-  return THREAD_RETURN_TYPE {}; \
+  return THREAD_RETURN_TYPE (); \
 } \
 
+template <typename RT, typename F>
+class deferredThreadSchedulerPool;
+
+template <typename RT, typename F>
+class taskAwaiter;
+
 template <typename RT = deafultThreadFunctionResult, typename F = defaulThreadFun<RT>>
 class deferredThreadScheduler final : public deferredThreadSchedulerBase
 {
-  // to make things simpler the thread function must return a value
-  static_assert(!std::is_void<RT>::value,
-                "The return value of the thread function must not be void");
+  // recycles the instances instead of destroying them
+  friend class deferredThreadSchedulerPool<RT, F>;
+  // reads the result when the task terminates, see coroutines.h
+  friend class taskAwaiter<RT, F>;
 
  public:
-  using threadResult = std::tuple<baseThreadStateType, RT>;
+  // the result of a void thread function is an empty std::monostate
+  using resultType = std::conditional_t<std::is_void_v<RT>, std::monostate, RT>;
+  using threadResult = std::tuple<baseThreadStateType, resultType>;
   using deferredTimeGranularity = std::chrono::nanoseconds;
 
 private:
-  mutable std::function<threadResult(const deferredTimeGranularity)> f_ {};
-  mutable std::shared_future<threadResult> threadFuture_ {};
+  // the call of the thread function with its own copies of the arguments,
+  // stored inline for typical callables
+  mutable inplaceTask<RT()> call_ {};
+  // the result of the last run, constructed in place: the future carries only
+  // the final thread state, so that results are neither default constructed
+  // nor copied through it
+  mutable std::optional<resultType> result_ {};
+  mutable std::atomic<bool> resultTaken_ {false};
+  // called with the result when the thread function returns, continuationDelay_
+  // later; shared with the timer job of a delayed call, which may outlive this
+  using continuation = inplaceTask<void(resultType&&)>;
+  mutable std::shared_ptr<continuation> continuation_ {};
+  mutable deferredTimeGranularity continuationDelay_ {0};
+  // called with the final state and the result, if any, whatever the way the
+  // task terminates
+  using completionCallback = inplaceTask<void(baseThreadStateType, const resultType*)>;
+  mutable completionCallback completionCallback_ {};
+  // the run of an instance with its own thread
+  mutable std::shared_future<baseThreadStateType> threadFuture_ {};
+
+  // the run of an instance using a timer service, reused by all the runs so
+  // that re-arming allocates nothing; guarded by cv_mx_, waited on cv_
+  struct runSlot
+  {
+    bool armed {false};
+    bool done {false};
+    // the timer was removed before expiring: no state, as a broken promise
+    bool dropped {false};
+    baseThreadStateType state {};
+    std::exception_ptr exception {};
+  };
+  mutable runSlot runSlot_ {};
+  // the deadline busy-waited in precision mode, or the deadline of the
+  // pending period of a periodic instance
+  mutable timerDeadline runDeadline_ {};
+  mutable deferredTimeGranularity period_ {};
+  mutable periodicMode periodicMode_ {periodicMode::fixedRate};
+
+  // the timer job of an instance using a timer service, stored by pointer in
+  // the entry of the timer service at every run, and at every period
+  class runTimer final : public timerTask
+  {
+   public:
+    explicit
+    runTimer(const deferredThreadScheduler* dts) noexcept
+    :
+    dts_(dts)
+    {}
+
+    void
+    fire() noexcept override
+    {
+      if ( dts_->isPeriodic() )
+      {
+        dts_->firePeriod_();
+        return;
+      }
+      dts_->fireRun_();
+    }
+
+    void
+    dropped() noexcept override
+    {
+      dts_->endRun_({}, {}, true);
+    }
 
-  std::shared_future<threadResult>&
+   private:
+    const deferredThreadScheduler* dts_;
+  };  // class runTimer
+  mutable runTimer runTimer_ {this};
+
+  std::shared_future<baseThreadStateType>&
   getThreadFuture() const noexcept
   {
     return threadFuture_;
   }
 
   void
-  setThreadFuture(const std::shared_future<threadResult>& r) const noexcept
+  setThreadFuture(const std::shared_future<baseThreadStateType>& r) const noexcept
   {
     threadFuture_ = r;
   }
 
- public:
-  deferredThreadScheduler() = delete;
-  deferredThreadScheduler(const deferredThreadScheduler& rhs) = delete;
-  deferredThreadScheduler& operator=(const deferredThreadScheduler& rhs) = delete;
-  deferredThreadScheduler(deferredThreadScheduler&& rhs) = delete;
-  deferredThreadScheduler& operator=(deferredThreadScheduler&& rhs) = delete;
+  // either the future or the slot holds the run, if any
+  bool
+  runValid_() const noexcept
+  {
+    if ( getThreadFuture().valid() )
+    {
+      return true;
+    }
+    std::lock_guard<std::mutex> lg(cv_mx_);
+    return runSlot_.armed;
+  }
 
-  ~deferredThreadScheduler() noexcept
+  void
+  runWait_() const noexcept
   {
-    auto tid = getThreadId();
-    // the dtor MUST NEVER be called manually.
-    // Remember: the std::future returned from std::async will block in its
-    // destructor until the asynchronously running thread has completed
-    // So, here, if the thread is still running we must force its termination by
-    // setting the cancellation flag and waiting its termination.
-    // This works only if the thread calls the static method isCancellationFlagSet()
-    // at a safe cancellation point of its code; otherwise the thread continues
-    // executing and the dtor never ends
-    if ( isRunning() )
+    if ( getThreadFuture().valid() )
     {
-      // this to notify the thread that must call isCancellationFlagSet() at a
-      // safe cancellation point of its code to verify its cancellation flag was set
-      setCancellationFlag(tid);
-      // then the thread must terminate and the dtor blocks here until done
-      terminate(tid);   
+      getThreadFuture().wait();
       return;
     }
-    // remove the entry for this thread from the static map
-    eraseCancellationFlag(tid);
+    std::unique_lock<std::mutex> lk(cv_mx_);
+    cv_.wait(lk, [this] () { return (false == runSlot_.armed) || runSlot_.done; });
   }
 
-  auto
-  terminate(const uniqueKey& tid) const noexcept(false)
+  // true if the run terminated within ns
+  bool
+  runWaitFor_(const std::chrono::nanoseconds ns) const noexcept(false)
   {
-    auto r = getThreadFuture().get();
-
-    // remove the entry for this thread from the static map
-    eraseCancellationFlag(tid);
-    return r;
+    if ( getThreadFuture().valid() )
+    {
+      return std::future_status::ready == getThreadFuture().wait_for(ns);
+    }
+    std::unique_lock<std::mutex> lk(cv_mx_);
+    return cv_.wait_for(lk, ns, [this] () { return (false == runSlot_.armed) || runSlot_.done; });
   }
-  constexpr
-  auto
-  terminate() const noexcept(false)
+
+  // wait the run and return its final state, throwing as std::future::get()
+  baseThreadStateType
+  runGet_() const noexcept(false)
   {
-    return terminate(getThreadId());
+    if ( getThreadFuture().valid() )
+    {
+      return getThreadFuture().get();
+    }
+    std::unique_lock<std::mutex> lk(cv_mx_);
+    if ( false == runSlot_.armed )
+    {
+      throw std::future_error(std::future_errc::no_state);
+    }
+    cv_.wait(lk, [this] () { return runSlot_.done; });
+    if ( nullptr != runSlot_.exception )
+    {
+      std::rethrow_exception(runSlot_.exception);
+    }
+    if ( runSlot_.dropped )
+    {
+      // cancelThread() removed the timer: the run terminated as Canceled
+      if ( threadState::Canceled == getThreadState_() )
+      {
+        return getThreadState();
+      }
+      throw std::future_error(std::future_errc::broken_promise);
+    }
+    return runSlot_.state;
   }
 
-  explicit
-  deferredThreadScheduler(const std::string& threadName) noexcept
-  :
-  deferredThreadSchedulerBase(threadName)
-  {}
-
-  template <typename... Args>
-  explicit
-  deferredThreadScheduler(const std::string& threadName, F& f, Args&&... args) noexcept
-  :
-  deferredThreadSchedulerBase(threadName)
+  void
+  clearRun_() const noexcept
   {
-    registerThread(std::forward<F>(f), std::forward<Args>(args)...);
+    setThreadFuture({});
+    std::lock_guard<std::mutex> lg(cv_mx_);
+    runSlot_ = runSlot {};
   }
 
-  template <typename... Args>
-  auto&
-  registerThread(const F& f, Args&&... args) const noexcept
+  // a new run completes into the slot
+  void
+  armRun_(const timerDeadline deadline) const noexcept
   {
-    if ( threadState::NotValid == getThreadState_() )
+    clearRun_();
     {
-      // create the closure
-      // NOTE:
-      //   - f MUST be captured by value; if passed by reference the same lambda
-      //     will be defined in all object instances created
-      f_ = [this, f, &args...]
-           (const deferredTimeGranularity deferredTime) noexcept(false) -> threadResult const
-           {
-             RT result {};
-
-             setThreadId();
-             std::unique_lock<std::mutex> lk(cv_mx_);
-             // wait on the condition variable until timeout or notification of cancellation
-             if ( std::cv_status r = cv_.wait_for(lk, deferredTime);
-                  std::cv_status::timeout == r )
-             {
-               if ( threadState::Scheduled == getThreadState_() )
-               {
-                 // run thread function
-                 setThreadState(threadState::Running);
-                 result = f(std::forward<Args>(args)...);
-                 setThreadState(threadState::Run);
-               }
-             }
-             return std::make_tuple(getThreadState(), result);
-           };
-      setThreadState(threadState::Registered);
+      std::lock_guard<std::mutex> lg(cv_mx_);
+      runSlot_.armed = true;
     }
-    // allow chain calls
-    return *this;
+    runDeadline_ = deadline;
   }
 
-  auto&
-  runIn(const double deferredTimeSeconds) const noexcept
+  // the waiter may destroy the instance as soon as the lock is released
+  void
+  endRun_(const baseThreadStateType ts,
+          const std::exception_ptr& e,
+          const bool dropped) const noexcept
   {
-    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(std::chrono::duration<double>{deferredTimeSeconds}));
+    std::lock_guard<std::mutex> lg(cv_mx_);
+    runSlot_.state = ts;
+    runSlot_.exception = e;
+    runSlot_.dropped = dropped;
+    runSlot_.done = true;
+    cv_.notify_all();
   }
-  auto&
-  runIn(const std::chrono::seconds deferredTime) const noexcept
+
+  // the job posted to the executor when the timer of this instance expires;
+  // in precision mode the timer expires spinMargin_ early and the job
+  // busy-waits the deadline, or waits it on the condition variable if too
+  // many threads are spinning, so that cancelThread() wakes it up at once
+  void
+  fireRun_() const noexcept
   {
-    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+    baseThreadStateType ts {};
+    std::exception_ptr e {};
+
+    try
+    {
+      if ( (spinMargin_ > deferredTimeGranularity::zero()) &&
+           (false == spinUntil(runDeadline_)) )
+      {
+        std::unique_lock<std::mutex> lk(cv_mx_);
+        cv_.wait_until(lk, runDeadline_, [this] () { return threadState::Scheduled != getThreadState_(); });
+      }
+      ts = runOnce_();
+    }
+    catch (...)
+    {
+      e = std::current_exception();
+    }
+    endRun_(ts, e, false);
   }
-  auto&
-  runIn(const std::chrono::milliseconds deferredTime) const noexcept
+
+  // an exception thrown by the thread function terminates the task at once,
+  // and is then propagated through the future as before
+  void
+  runThreadFunction_() const noexcept(false)
   {
-    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+    try
+    {
+      if constexpr ( std::is_void_v<RT> )
+      {
+        call_();
+        result_.emplace();
+      }
+      else
+      {
+        result_.emplace(call_());
+      }
+    }
+    catch (const std::exception& e)
+    {
+      setExceptionThrownMessage(e.what());
+      setThreadState(threadState::ExceptionThrown);
+      completed(threadState::ExceptionThrown);
+      throw;
+    }
   }
-  auto&
-  runIn(const std::chrono::microseconds deferredTime) const noexcept
+
+  void
+  completed(const threadState ts) const noexcept override
   {
-    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+    if ( completionCallback_ )
+    {
+      try
+      {
+        completionCallback_(static_cast<baseThreadStateType>(ts),
+                            ((threadState::Run == ts) && result_.has_value()) ? &*result_ : nullptr);
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << "[" << __func__ << "] "
+                  << "completion callback terminated by exception: "
+                  << e.what()
+                  << std::endl;
+      }
+    }
+    deferredThreadSchedulerBase::completed(ts);
   }
-  auto&
-  runIn(const deferredTimeGranularity deferredTime) const noexcept
+
+  // as if just built with threadName, reusing the storage of the instance: a
+  // pending task is canceled first, and a running one waited for
+  void
+  recycle_(const std::string& threadName) const noexcept
+  {
+    reset();
+    call_.reset();
+    continuation_.reset();
+    continuationDelay_ = deferredTimeGranularity::zero();
+    completionCallback_.reset();
+    result_.reset();
+    resultTaken_.store(false, std::memory_order_relaxed);
+    clearRun_();
+    clearThreadState(threadName);
+  }
+
+  // hand the result over to the continuation, if any
+  void
+  runContinuation_() const noexcept(false)
   {
-    if ( threadState::Registered == getThreadState_() )
+    if ( nullptr == continuation_ )
     {
-      setThreadState(threadState::Scheduled);
-      // run the closure async
-      setThreadFuture(reallyAsync(f_, deferredTime));
+      return;
     }
-    // allow chain calls
-    return *this;
+    resultTaken_.store(true);
+    if ( continuationDelay_ <= deferredTimeGranularity::zero() )
+    {
+      (*continuation_)(std::move(*result_));
+      return;
+    }
+
+    auto& ts {(nullptr == timerService_) ? timerService::defaultTimerService() : *timerService_};
+    ts.schedule(timerClock::now() + continuationDelay_,
+                [c = continuation_, r = std::make_shared<resultType>(std::move(*result_))] ()
+                {
+                  (*c)(std::move(*r));
+                },
+                executor_);
   }
 
-  // blocking until the thread terminates or return default values if not in the
-  // right state
-  threadResult
-  wait() const noexcept(false)
+  // block until the thread terminates and return its final state; an
+  // exception thrown by the thread function moves it to ExceptionThrown
+  baseThreadStateType
+  join_() const noexcept(false)
   {
     auto ts {getThreadState()};
 
@@ -489,31 +931,757 @@ private:
       try
       {
         // wait here the termination
-        return terminate();
+        return runGet_();
       }
       catch (const std::exception& e)
       {
-        // remove the entry for this thread from the static map
-        eraseCancellationFlag(getThreadId());
+        // a run canceled meanwhile keeps its terminal state
+        if ( threadState::Canceled == getThreadState_() )
+        {
+          return getThreadState();
+        }
         setExceptionThrownMessage(e.what());
         setThreadState(threadState::ExceptionThrown);
-        return std::make_tuple(getThreadState(), RT {});
+        return getThreadState();
       }
     }
-    // if the thread is not in the right state then return here with default
-    // values indicating the thread state and the default return type
-    return std::make_tuple(ts, RT{});
+    return ts;
   }
 
-  // wait at most s seconds for thread termination, then return no result
-  // in case of time-out, otherwise return the result/future if the thread terminated
+  // a copy of the result of a terminated thread, or a default one
   threadResult
-  wait_for(const std::chrono::seconds s) const noexcept(false)
+  copyResult_(const baseThreadStateType ts) const noexcept(false)
   {
-    return wait_for(std::chrono::duration_cast<std::chrono::nanoseconds>(s));
+    if ( (threadState::ExceptionThrown != static_cast<threadState>(ts)) &&
+         result_.has_value() &&
+         (false == resultTaken_.load()) )
+    {
+      return std::make_tuple(ts, *result_);
+    }
+    return std::make_tuple(ts, resultType {});
   }
-  // wait at most ms milliseconds for thread termination, then return no result
-  // in case of time-out, otherwise return the result/future if the thread terminated
+
+  // the final state and a copy of the result of a terminated instance, read
+  // without waiting on its future: from a completion job, which may run while
+  // the continuation, if any, still moves the result away, in which case the
+  // result is a default one as wait() would find
+  threadResult
+  terminatedResult_() const noexcept(false)
+  {
+    auto ts {getThreadState()};
+
+    if ( nullptr != continuation_ )
+    {
+      return std::make_tuple(ts, resultType {});
+    }
+    return copyResult_(ts);
+  }
+
+  // the thread of a periodic instance not using a timer service runs all the
+  // periods, waiting on the condition variable in between
+  static
+  baseThreadStateType
+  waitAndRunEvery_(const deferredThreadScheduler* dts,
+                   timerDeadline deadline,
+                   const deferredTimeGranularity period,
+                   const periodicMode mode) noexcept(false)
+  {
+    dts->setThreadId();
+    dts->pinOwnThread();
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lk(dts->cv_mx_);
+        if ( dts->cv_.wait_until(lk,
+                                 deadline,
+                                 [dts] () { return threadState::Scheduled != dts->getThreadState_(); }) )
+        {
+          return dts->getThreadState();
+        }
+      }
+      if ( false == dts->runPeriod_() )
+      {
+        return dts->getThreadState();
+      }
+      deadline = dts->nextPeriodDeadline(deadline, period, mode);
+      if ( (false == dts->transitionThreadState(threadState::Running, threadState::Scheduled)) ||
+           dts->stoppedAfterPeriod_() )
+      {
+        return dts->getThreadState();
+      }
+    }
+  }
+
+  // run a period of a periodic instance using a timer service, then arm
+  // runTimer_ again for the next one; the slot completes when the instance
+  // stops, or is dropped if the pending timer is removed
+  void
+  firePeriod_() const noexcept
+  {
+    try
+    {
+      setThreadId();
+      if ( (false == runPeriod_()) )
+      {
+        endRun_(getThreadState(), {}, false);
+        return;
+      }
+      runDeadline_ = nextPeriodDeadline(runDeadline_, period_, periodicMode_);
+      if ( (false == transitionThreadState(threadState::Running, threadState::Scheduled)) ||
+           stoppedAfterPeriod_() )
+      {
+        endRun_(getThreadState(), {}, false);
+        return;
+      }
+      storeTimerId_(timerService_->schedule(runDeadline_, runTimer_, taskExecutor_()));
+    }
+    catch (...)
+    {
+      endRun_({}, std::current_exception(), false);
+    }
+  }
+
+  // a single run of the thread function, moving the thread state
+  baseThreadStateType
+  runOnce_() const noexcept(false)
+  {
+    setThreadId();
+    // either this or cancelThread() wins the transition from Scheduled
+    if ( false == transitionThreadState(threadState::Scheduled, threadState::Running) )
+    {
+      return getThreadState();
+    }
+    // run thread function
+    {
+      stopToken::scope sts(stopToken_);
+      runThreadFunction_();
+    }
+    ++executions_;
+    setThreadState(threadState::Run);
+    completed(threadState::Run);
+    runContinuation_();
+    return getThreadState();
+  }
+
+  // one run of a periodic instance; false if it was canceled, before the run
+  // or while running
+  bool
+  runPeriod_() const noexcept(false)
+  {
+    if ( false == transitionThreadState(threadState::Scheduled, threadState::Running) )
+    {
+      return false;
+    }
+    {
+      stopToken::scope sts(stopToken_);
+      runThreadFunction_();
+    }
+    ++executions_;
+    if ( stopToken_.stopRequested() )
+    {
+      setThreadState(threadState::Canceled);
+      completed(threadState::Canceled);
+      return false;
+    }
+    return true;
+  }
+
+  // called once a period moved the state back to Scheduled: true if
+  // cancelThread() requested the stop of the period meanwhile, the state being
+  // then Canceled; the fence pairs with the one in cancelThread(), so that
+  // either this sees the stop, or cancelThread() sees Scheduled and cancels
+  // the next period itself
+  bool
+  stoppedAfterPeriod_() const noexcept
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if ( false == stopToken_.stopRequested() )
+    {
+      return false;
+    }
+    // cancelThread() may have won the transition from Scheduled
+    if ( transitionThreadState(threadState::Scheduled, threadState::Canceled) )
+    {
+      completed(threadState::Canceled);
+    }
+    return true;
+  }
+
+  // arm the run slot and return the timer of runTimer_ for deadline
+  timerService::timerRequest
+  makeTimerRequest_(const timerDeadline deadline) const noexcept
+  {
+    armRun_(deadline);
+    return {(spinMargin_ > deferredTimeGranularity::zero()) ? deadline - spinMargin_ : deadline,
+            {},
+            taskExecutor_(),
+            &runTimer_};
+  }
+
+  // the thread of an instance not using a timer service waits here on the
+  // condition variable until the deadline or notification of cancellation
+  template <typename Clock, typename Duration>
+  static
+  baseThreadStateType
+  waitAndRun_(const deferredThreadScheduler* dts,
+              const std::chrono::time_point<Clock, Duration> deadline) noexcept(false)
+  {
+    auto isNotScheduled = [dts] () { return threadState::Scheduled != dts->getThreadState_(); };
+
+    dts->setThreadId();
+    dts->pinOwnThread();
+    {
+      std::unique_lock<std::mutex> lk(dts->cv_mx_);
+      if ( dts->cv_.wait_until(lk, deadline - dts->spinMargin_, isNotScheduled) )
+      {
+        return dts->getThreadState();
+      }
+    }
+    // precision mode: busy-wait the margin left, or sleep it if too many
+    // threads are spinning
+    if ( (dts->spinMargin_ > deferredTimeGranularity::zero()) &&
+         (false == dts->spinUntil(deadline)) )
+    {
+      std::unique_lock<std::mutex> lk(dts->cv_mx_);
+      if ( dts->cv_.wait_until(lk, deadline, isNotScheduled) )
+      {
+        return dts->getThreadState();
+      }
+    }
+    return dts->runOnce_();
+  }
+
+ public:
+  deferredThreadScheduler() = delete;
+  deferredThreadScheduler(const deferredThreadScheduler& rhs) = delete;
+  deferredThreadScheduler& operator=(const deferredThreadScheduler& rhs) = delete;
+  deferredThreadScheduler(deferredThreadScheduler&& rhs) = delete;
+  deferredThreadScheduler& operator=(deferredThreadScheduler&& rhs) = delete;
+
+  ~deferredThreadScheduler() noexcept
+  {
+    // the dtor MUST NEVER be called manually.
+    // Remember: the std::future returned from std::async will block in its
+    // destructor until the asynchronously running thread has completed
+    // So, here, if the thread is still running we must force its termination by
+    // requesting a stop on its token and waiting its termination.
+    // This works only if the thread calls the static method isCancellationFlagSet()
+    // at a safe cancellation point of its code; otherwise the thread continues
+    // executing and the dtor never ends
+    // a periodic task would be scheduled again forever
+    if ( isPeriodic() )
+    {
+      cancelThread();
+    }
+    if ( isRunning() )
+    {
+      // this to notify the thread that must call isCancellationFlagSet() at a
+      // safe cancellation point of its code to verify its stop was requested
+      stopToken_.requestStop();
+      // then the thread must terminate and the dtor blocks here until done
+      runWait_();
+      return;
+    }
+    // the job of a shared timer references this object: wait until it is
+    // either removed from the timer service or run to completion
+    if ( (nullptr != timerService_) && runValid_() )
+    {
+      runWait_();
+    }
+  }
+
+  threadResult
+  terminate() const noexcept(false)
+  {
+    return copyResult_(runGet_());
+  }
+  auto
+  terminate(const uniqueKey& tid) const noexcept(false)
+  {
+    auto r = terminate();
+
+    // remove the entry for this thread from the static registry
+    eraseCancellationFlag(tid);
+    return r;
+  }
+
+  explicit
+  deferredThreadScheduler(const std::string& threadName) noexcept
+  :
+  deferredThreadSchedulerBase(threadName)
+  {}
+
+  deferredThreadScheduler(const std::string& threadName, executor& ex) noexcept
+  :
+  deferredThreadSchedulerBase(threadName)
+  {
+    useExecutor(ex);
+  }
+
+  template <typename... Args>
+  explicit
+  deferredThreadScheduler(const std::string& threadName, F& f, Args&&... args) noexcept
+  :
+  deferredThreadSchedulerBase(threadName)
+  {
+    registerThread(std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  auto&
+  registerThread(const F& f, Args&&... args) const noexcept
+  {
+    if ( threadState::NotValid == getThreadState_() )
+    {
+      // create the closure
+      // NOTE:
+      //   - f and the arguments are stored by value, decayed as std::thread
+      //     does: the caller may pass temporaries, and std::ref() to pass a
+      //     reference
+      call_ = [this,
+               fun = std::decay_t<F>(f),
+               boundArgs = std::make_tuple(std::forward<Args>(args)...)] () mutable noexcept(false) -> RT
+              {
+                return std::apply([this, &fun] (auto&... a) -> RT
+                                  {
+                                    // the stop token is passed to the thread
+                                    // function if it takes the token as its
+                                    // first argument
+                                    if constexpr ( std::is_invocable_v<std::decay_t<F>&, const stopToken&, decltype(a)...> )
+                                    {
+                                      return fun(stopToken_, a...);
+                                    }
+                                    else
+                                    {
+                                      return fun(a...);
+                                    }
+                                  },
+                                  boundArgs);
+              };
+      setThreadState(threadState::Registered);
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  auto&
+  runIn(const double deferredTimeSeconds) const noexcept
+  {
+    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(std::chrono::duration<double>{deferredTimeSeconds}));
+  }
+  auto&
+  runIn(const std::chrono::seconds deferredTime) const noexcept
+  {
+    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+  }
+  auto&
+  runIn(const std::chrono::milliseconds deferredTime) const noexcept
+  {
+    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+  }
+  auto&
+  runIn(const std::chrono::microseconds deferredTime) const noexcept
+  {
+    return runIn(std::chrono::duration_cast<deferredTimeGranularity>(deferredTime));
+  }
+  auto&
+  runIn(const deferredTimeGranularity deferredTime) const noexcept
+  {
+    // the deadline is taken now, not when the thread or the timer starts
+    return runAt(timerClock::now() + deferredTime);
+  }
+
+  // run at an absolute deadline of the steady clock: many instances can be
+  // scheduled against the same precomputed time point
+  auto&
+  runAt(const timerDeadline deadline) const noexcept
+  {
+    if ( transitionThreadState(threadState::Registered, threadState::Scheduled) )
+    {
+      if ( nullptr == timerService_ )
+      {
+        // run the closure async
+        setThreadFuture(reallyAsync(waitAndRun_<timerClock, timerDeadline::duration>, this, deadline));
+      }
+      else
+      {
+        // the timer thread hands the closure over to an execution thread
+        // when the deadline is reached
+        auto request = makeTimerRequest_(deadline);
+
+        storeTimerId_(timerService_->schedule(request.deadline,
+                                              *request.task,
+                                              request.ex));
+      }
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // run at a wall clock time; a dedicated thread waits on the system clock,
+  // while a timer service, which runs on the steady clock, takes the time
+  // left from now
+  auto&
+  runAt(const std::chrono::system_clock::time_point deadline) const noexcept
+  {
+    if ( nullptr != timerService_ )
+    {
+      return runAt(timerClock::now() + (deadline - std::chrono::system_clock::now()));
+    }
+    if ( transitionThreadState(threadState::Registered, threadState::Scheduled) )
+    {
+      using systemDeadline = std::chrono::system_clock::time_point;
+
+      setThreadFuture(reallyAsync(waitAndRun_<std::chrono::system_clock, systemDeadline::duration>, this, deadline));
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // run every period, the first time a period from now, until canceled; the
+  // same closure and, without a timer service, the same thread serve all the
+  // runs, or with one the same timer job, so that a period allocates nothing;
+  // wait() returns when the task is canceled
+  auto&
+  runEvery(const deferredTimeGranularity period,
+           const periodicMode mode = periodicMode::fixedRate) const noexcept
+  {
+    if ( (period > deferredTimeGranularity::zero()) &&
+         transitionThreadState(threadState::Registered, threadState::Scheduled) )
+    {
+      auto deadline = timerClock::now() + period;
+
+      periodic_.store(true);
+      if ( nullptr == timerService_ )
+      {
+        setThreadFuture(reallyAsync(waitAndRunEvery_, this, deadline, period, mode));
+      }
+      else
+      {
+        period_ = period;
+        periodicMode_ = mode;
+        armRun_(deadline);
+        storeTimerId_(timerService_->schedule(deadline, runTimer_, taskExecutor_()));
+      }
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // start the task within a few microseconds of its deadline: sleep until
+  // spinMargin before it, then busy-wait; a zero margin turns the precision
+  // mode off; it must be called before runIn() or runAt()
+  auto&
+  usePrecisionMode(const deferredTimeGranularity spinMargin = std::chrono::microseconds(200)) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      spinMargin_ = std::max(spinMargin, deferredTimeGranularity::zero());
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // serve this instance by the timer thread of ts, shared with all the other
+  // instances using it, instead of a thread of its own; it must be called
+  // before runIn()
+  auto&
+  useTimerService(timerService& ts = timerService::defaultTimerService()) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      timerService_ = &ts;
+      retargetPriority_();
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // run the task on ex when the timer expires, e.g. on a workerPool so that
+  // many tasks due at the same time share a fixed number of threads; the
+  // default timer service is used if none was set; it must be called before
+  // runIn()
+  auto&
+  useExecutor(executor& ex) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      if ( nullptr == timerService_ )
+      {
+        useTimerService();
+      }
+      executor_ = &ex;
+      retargetPriority_();
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // when the timer expires the task is posted at priority p, 0 being the
+  // highest: a saturated workerPool starts the tasks of higher priority
+  // first; the instances waiting on a thread of their own run at once
+  // anyway; it must be called before runIn()
+  auto&
+  setPriority(const executor::priority p) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      priority_ = std::min(p, executor::lowestPriority);
+      retargetPriority_();
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // pin the thread an instance without a timer service waits and runs on to
+  // cpus, on Linux, instead of letting it run wherever std::async starts it;
+  // the tasks using a timer service run on the threads of its executor, which
+  // are pinned through the executor instead; it must be called before runIn()
+  auto&
+  setAffinity(const cpuSet& cpus) const noexcept(false)
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      affinity_ = cpus;
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // call next with the result, moved, when the thread function returns: on
+  // the thread that ran it, or delay later on the executor of the timer
+  // service, so that no thread blocks waiting for this task to chain the next
+  // step; next takes the result, or nothing for a void thread function, and is
+  // not called if the task is canceled or throws; wait() and take() find no
+  // result afterwards; it must be called before runIn()
+  template <typename G>
+  auto&
+  then(G&& next, const deferredTimeGranularity delay = deferredTimeGranularity::zero()) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      continuation_ = std::make_shared<continuation>([g = std::decay_t<G>(std::forward<G>(next))] (resultType&& r) mutable
+                                                     {
+                                                       if constexpr ( std::is_invocable_v<std::decay_t<G>&, resultType&&> )
+                                                       {
+                                                         g(std::move(r));
+                                                       }
+                                                       else
+                                                       {
+                                                         g();
+                                                       }
+                                                     });
+      continuationDelay_ = delay;
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // call done with the final state and a pointer to the result, nullptr if
+  // none, as soon as the task terminates, whether it has run, has been
+  // canceled or has thrown: no thread has to poll wait_for() to learn it;
+  // done runs on the thread that terminated the task, before then() takes the
+  // result, and must not block; it must be called before runIn(); an empty
+  // done, e.g. an empty std::function, throws std::invalid_argument
+  template <typename G>
+  auto&
+  onCompletion(G&& done) const noexcept(false)
+  {
+    if constexpr ( std::is_constructible_v<bool, const std::decay_t<G>&> )
+    {
+      if ( false == static_cast<bool>(done) )
+      {
+        throw std::invalid_argument("onCompletion: empty callable");
+      }
+    }
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      completionCallback_ = std::forward<G>(done);
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // push the termination of the task to q, whatever the way it terminates,
+  // so that a consumer thread learns the completions of many instances in
+  // batches; the instance must outlive its completion in q; it must be called
+  // before runIn()
+  auto&
+  useCompletionQueue(completionQueue& q) const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::NotValid == ts_) ||
+         (threadState::Registered == ts_) )
+    {
+      completionQueue_ = &q;
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // return a terminated instance to Registered, so that it can be scheduled
+  // again reusing its closure, its copies of the arguments and its settings;
+  // a pending instance is canceled first, and a running one waited for, so it
+  // must not be called by the thread function itself; the counters keep
+  // counting across the runs
+  auto&
+  reset() const noexcept
+  {
+    if ( auto ts_ {getThreadState_()};
+         (threadState::Scheduled == ts_) ||
+         (threadState::Running == ts_) )
+    {
+      cancelThread();
+    }
+    if ( runValid_() )
+    {
+      runWait_();
+    }
+    if ( resetThreadState() )
+    {
+      result_.reset();
+      resultTaken_.store(false);
+      clearRun_();
+    }
+    // allow chain calls
+    return *this;
+  }
+
+  // reset() and schedule again: re-arming the same timeout over and over
+  // needs no new instance
+  auto&
+  rearm(const timerDeadline deadline) const noexcept
+  {
+    return reset().runAt(deadline);
+  }
+  auto&
+  rearm(const deferredTimeGranularity deferredTime) const noexcept
+  {
+    return reset().runIn(deferredTime);
+  }
+
+  // schedule all the instances in dtss, a range of instances or of pointers to
+  // them, to run in deferredTime from now; consecutive instances sharing a
+  // timer service are armed under a single lock acquisition of it and wake up
+  // its timer thread at most once; the timer ids are returned in the order of
+  // dtss, invalidTimerId for instances not scheduled by a timer service
+  template <typename Range>
+  static
+  std::vector<timerService::timerId>
+  runAllIn(const Range& dtss, const deferredTimeGranularity deferredTime) noexcept(false)
+  {
+    return runAllAt(dtss, timerClock::now() + deferredTime);
+  }
+
+  // as runAllIn(), at an absolute deadline of the steady clock
+  template <typename Range>
+  static
+  std::vector<timerService::timerId>
+  runAllAt(const Range& dtss, const timerDeadline deadline) noexcept(false)
+  {
+    std::vector<timerService::timerId> ids {};
+    std::vector<timerService::timerRequest> requests {};
+    std::vector<std::pair<const deferredThreadScheduler*, std::size_t>> armed {};
+    timerService* ts {nullptr};
+
+    auto flush = [&ids, &requests, &armed, &ts] ()
+                 {
+                   if ( requests.empty() )
+                   {
+                     return;
+                   }
+                   auto batchIds = ts->schedule(std::move(requests));
+                   for (std::size_t i {}; i < armed.size(); ++i)
+                   {
+                     armed[i].first->storeTimerId_(batchIds[i]);
+                     ids[armed[i].second] = batchIds[i];
+                   }
+                   requests.clear();
+                   armed.clear();
+                 };
+
+    for (auto& element : dtss)
+    {
+      const deferredThreadScheduler* dts {nullptr};
+      if constexpr ( std::is_convertible_v<decltype(element), const deferredThreadScheduler&> )
+      {
+        dts = &element;
+      }
+      else
+      {
+        dts = &(*element);
+      }
+
+      ids.push_back(timerService::invalidTimerId);
+      if ( nullptr == dts->timerService_ )
+      {
+        dts->runAt(deadline);
+        continue;
+      }
+      if ( dts->timerService_ != ts )
+      {
+        flush();
+        ts = dts->timerService_;
+      }
+      if ( dts->transitionThreadState(threadState::Registered, threadState::Scheduled) )
+      {
+        requests.push_back(dts->makeTimerRequest_(deadline));
+        armed.emplace_back(dts, ids.size() - 1);
+      }
+    }
+    flush();
+    return ids;
+  }
+
+  // blocking until the thread terminates or return default values if not in the
+  // right state; the result is copied, see take() to move it out
+  threadResult
+  wait() const noexcept(false)
+  {
+    return copyResult_(join_());
+  }
+
+  // blocking until the thread terminates, then move the result out: it is
+  // taken exactly once, later calls and wait() find no result; the result of
+  // a thread function returning a type that is not copyable or not default
+  // constructible can be obtained only here
+  std::tuple<baseThreadStateType, std::optional<resultType>>
+  take() const noexcept(false)
+  {
+    auto ts {join_()};
+
+    if ( (threadState::ExceptionThrown != static_cast<threadState>(ts)) &&
+         result_.has_value() &&
+         (false == resultTaken_.exchange(true)) )
+    {
+      return std::make_tuple(ts, std::optional<resultType> {std::move(*result_)});
+    }
+    return std::make_tuple(ts, std::optional<resultType> {});
+  }
+
+  // wait at most s seconds for thread termination, then return no result
+  // in case of time-out, otherwise return the result/future if the thread terminated
+  threadResult
+  wait_for(const std::chrono::seconds s) const noexcept(false)
+  {
+    return wait_for(std::chrono::duration_cast<std::chrono::nanoseconds>(s));
+  }
+  // wait at most ms milliseconds for thread termination, then return no result
+  // in case of time-out, otherwise return the result/future if the thread terminated
   threadResult
   wait_for(const std::chrono::milliseconds ms) const noexcept(false)
   {
@@ -538,27 +1706,13 @@ private:
            (threadState::Running == ts_) ||
            (threadState::Run == ts_)) )
     {
-      if ( std::future_status::ready == getThreadFuture().wait_for(ns) )
+      if ( runWaitFor_(ns) )
       {
-        // an exception thrown inside an async task is propagated when
-        // std::future::get() is invoked.
-        try
-        {
-          // wait here the termination
-          return terminate();
-        }
-        catch (const std::exception& e)
-        {
-          // remove the entry for this thread from the static map
-          eraseCancellationFlag(getThreadId());
-          setExceptionThrownMessage(e.what());
-          setThreadState(threadState::ExceptionThrown);
-          return std::make_tuple(getThreadState(), RT {});
-        }
+        return wait();
       }
     }
     // return after time-out: thread not terminated
-    return std::make_tuple(ts, RT{});
+    return std::make_tuple(ts, resultType {});
   }
 
   static
@@ -571,7 +1725,7 @@ private:
   bool
   isCancellationFlagSet() noexcept
   {
-    return true == getCancellationFlag(std::this_thread::get_id());
+    return deferredThreadSchedulerBase::isCancellationFlagSet();
   }
 };  // class deferredThreadScheduler
 
@@ -595,6 +1749,13 @@ makeUniqueDeferredThreadScheduler(const std::string& threadName) noexcept
 {
   return createUniquePtr<deferredThreadScheduler<T, F>>(threadName);
 }
+
+template <typename T, typename F>
+deferredThreadSchedulerUniquePtr<T, F>
+makeUniqueDeferredThreadScheduler(const std::string& threadName, executor& ex) noexcept
+{
+  return createUniquePtr<deferredThreadScheduler<T, F>>(threadName, ex);
+}
 ////////////////////////////////////////////////////////////////////////////////
 template <typename T, typename F>
 using deferredThreadSchedulerSharedPtr = std::shared_ptr<deferredThreadScheduler<T, F>>;
@@ -613,4 +1774,11 @@ makeSharedDeferredThreadScheduler(const std::string& threadName) noexcept
 {
   return createSharedPtr<deferredThreadScheduler<T, F>>(threadName);
 }
+
+template <typename T, typename F>
+deferredThreadSchedulerSharedPtr<T, F>
+makeSharedDeferredThreadScheduler(const std::string& threadName, executor& ex) noexcept
+{
+  return createSharedPtr<deferredThreadScheduler<T, F>>(threadName, ex);
+}
 }  // namespace DTS
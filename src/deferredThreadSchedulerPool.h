@@ -0,0 +1,307 @@
+/*
+ * File:   deferredThreadSchedulerPool.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 6:20 PM
+ */
+#pragma once
+
+#include "deferredThreadScheduler.h"
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+// A pool of deferredThreadScheduler instances in fixed-size slots recycled
+// through a free list. A released instance is not destroyed: it goes back to
+// NotValid in place, keeping its storage, and is handed out again. In the
+// steady state acquiring and releasing an instance touches no allocator and
+// constructs nothing.
+// The slots are allocated in chunks that are never moved nor freed until the
+// pool is destroyed. Every slot counts its recycles in a generation, so a
+// handle to an instance released meanwhile is detected as stale instead of
+// reaching the instance handed out later from the same slot.
+template <typename RT = deafultThreadFunctionResult, typename F = defaulThreadFun<RT>>
+class deferredThreadSchedulerPool final
+{
+ public:
+  using scheduler = deferredThreadScheduler<RT, F>;
+  using slotIndex = std::uint32_t;
+  using generation = std::uint32_t;
+
+  static constexpr std::size_t slotsPerChunk {64};
+  static constexpr std::size_t maxChunks {16384};
+
+  // refers to an instance of the pool; handles are copied freely and become
+  // stale when the instance is released
+  class handle final
+  {
+   public:
+    handle() = default;
+
+    // the instance, or nullptr if it has been released
+    scheduler*
+    get() const noexcept
+    {
+      if ( nullptr == pool_ )
+      {
+        return nullptr;
+      }
+      return pool_->lookup(index_, generation_);
+    }
+
+    bool
+    valid() const noexcept
+    {
+      return nullptr != get();
+    }
+
+    explicit
+    operator bool() const noexcept
+    {
+      return valid();
+    }
+
+    scheduler*
+    operator->() const noexcept(false)
+    {
+      return checked();
+    }
+
+    scheduler&
+    operator*() const noexcept(false)
+    {
+      return *checked();
+    }
+
+   private:
+    friend class deferredThreadSchedulerPool;
+
+    const deferredThreadSchedulerPool* pool_ {nullptr};
+    slotIndex index_ {};
+    generation generation_ {};
+
+    handle(const deferredThreadSchedulerPool* pool, const slotIndex index, const generation g) noexcept
+    :
+    pool_ (pool),
+    index_ (index),
+    generation_ (g)
+    {}
+
+    scheduler*
+    checked() const noexcept(false)
+    {
+      if ( auto dts {get()};
+           nullptr != dts )
+      {
+        return dts;
+      }
+      throw std::logic_error("deferredThreadSchedulerPool: stale handle");
+    }
+  };  // class handle
+
+  deferredThreadSchedulerPool(const deferredThreadSchedulerPool& rhs) = delete;
+  deferredThreadSchedulerPool& operator=(const deferredThreadSchedulerPool& rhs) = delete;
+  deferredThreadSchedulerPool(deferredThreadSchedulerPool&& rhs) = delete;
+  deferredThreadSchedulerPool& operator=(deferredThreadSchedulerPool&& rhs) = delete;
+
+  // reserve at least initialSlots slots up front
+  explicit
+  deferredThreadSchedulerPool(const std::size_t initialSlots = slotsPerChunk) noexcept(false)
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+
+    // the table of the chunks is never reallocated, so that handles look up
+    // their slots without locking
+    chunks_.reserve(maxChunks);
+    while ( capacity_ < initialSlots )
+    {
+      grow();
+    }
+  }
+
+  // all the instances are destroyed: as for any instance, the pending tasks
+  // of those still acquired must be canceled or terminated first
+  ~deferredThreadSchedulerPool() noexcept
+  {
+    for (slotIndex i {}; i < capacity_; ++i)
+    {
+      if ( auto& s {slotAt(i)};
+           s.constructed )
+      {
+        s.get()->~scheduler();
+      }
+    }
+  }
+
+  // a new instance, or a recycled one as if new
+  handle
+  acquire(const std::string& threadName) noexcept(false)
+  {
+    slotIndex i {};
+    {
+      std::lock_guard<std::mutex> lg(mx_);
+
+      i = popFree();
+      ++size_;
+    }
+
+    // the slot is owned by this call now
+    auto& s {slotAt(i)};
+    if ( s.constructed )
+    {
+      s.get()->threadName_ = threadName;
+    }
+    else
+    {
+      ::new (static_cast<void*>(&s.storage)) scheduler(threadName);
+      s.constructed = true;
+    }
+    return {this, i, s.gen.load()};
+  }
+
+  handle
+  acquire(const std::string& threadName, executor& ex) noexcept(false)
+  {
+    auto h {acquire(threadName)};
+
+    h->useExecutor(ex);
+    return h;
+  }
+
+  // cancel the pending task of the instance and recycle it; false if the
+  // handle is stale; as the destructor of an instance, it blocks until a
+  // running task terminates
+  bool
+  release(const handle& h) noexcept
+  {
+    if ( this != h.pool_ )
+    {
+      return false;
+    }
+
+    // every handle to the instance is stale from now on; of concurrent
+    // releases of the same instance only one wins
+    auto& s {slotAt(h.index_)};
+    if ( auto g {h.generation_};
+         false == s.gen.compare_exchange_strong(g, g + 1) )
+    {
+      return false;
+    }
+    // not holding the lock, as it may have to wait for the task; the closure
+    // and the captures it holds are released here
+    s.get()->recycle_(emptyName_);
+
+    std::lock_guard<std::mutex> lg(mx_);
+    s.nextFree = freeList_;
+    freeList_ = h.index_;
+    --size_;
+    return true;
+  }
+
+  // the instances acquired and not released
+  std::size_t
+  size() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    return size_;
+  }
+
+  // the slots allocated, acquired or free
+  std::size_t
+  capacity() const noexcept
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    return capacity_;
+  }
+
+ private:
+  static constexpr slotIndex noSlot {std::numeric_limits<slotIndex>::max()};
+
+  struct slot
+  {
+    std::aligned_storage_t<sizeof(scheduler), alignof(scheduler)> storage {};
+    std::atomic<generation> gen {0};
+    bool constructed {false};
+    slotIndex nextFree {noSlot};
+
+    scheduler*
+    get() noexcept
+    {
+      return std::launder(reinterpret_cast<scheduler*>(&storage));
+    }
+  };
+
+  const std::string emptyName_ {};
+  mutable std::mutex mx_ {};
+  std::vector<std::unique_ptr<slot[]>> chunks_ {};
+  slotIndex capacity_ {0};
+  std::size_t size_ {0};
+  slotIndex freeList_ {noSlot};
+
+  slot&
+  slotAt(const slotIndex i) const noexcept
+  {
+    return chunks_[i / slotsPerChunk][i % slotsPerChunk];
+  }
+
+  scheduler*
+  lookup(const slotIndex i, const generation g) const noexcept
+  {
+    // the chunks are only appended, never moved, and a handle refers to a
+    // slot of a chunk that existed when it was acquired
+    auto& s {slotAt(i)};
+
+    if ( g != s.gen.load() )
+    {
+      return nullptr;
+    }
+    return s.get();
+  }
+
+  void
+  grow() noexcept(false)
+  {
+    if ( chunks_.size() == maxChunks )
+    {
+      throw std::length_error("deferredThreadSchedulerPool: too many instances");
+    }
+    chunks_.push_back(std::make_unique<slot[]>(slotsPerChunk));
+    // link the new slots in index order
+    for (auto i {slotsPerChunk}; i > 0; --i)
+    {
+      auto index = static_cast<slotIndex>(capacity_ + i - 1);
+      slotAt(index).nextFree = freeList_;
+      freeList_ = index;
+    }
+    capacity_ = static_cast<slotIndex>(capacity_ + slotsPerChunk);
+  }
+
+  slotIndex
+  popFree() noexcept(false)
+  {
+    if ( noSlot == freeList_ )
+    {
+      grow();
+    }
+
+    auto i {freeList_};
+    freeList_ = slotAt(i).nextFree;
+    return i;
+  }
+};  // class deferredThreadSchedulerPool
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
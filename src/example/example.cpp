@@ -42,6 +42,10 @@ auto main() -> int
   std::cout << "[" << __func__ << "] "
             << "Registered: OK\n";
 
+  // the termination of the thread is pushed here: no need to poll its state
+  completionQueue completions {};
+  dts.useCompletionQueue(completions);
+
   // the deferred time in seconds
   auto deferredTime {4s};
   // schedule the thread to run in deferredTime seconds from now
@@ -57,14 +61,12 @@ auto main() -> int
   std::cout << "[" << __func__ << "] "
             << "Scheduled: OK\n";
 
-  // wait here the end of the thread
-  auto [threadState, threadResult] = dts.wait_for(3950ms);
+  // sleep until the thread terminates, just some more time after the
+  // deferred time at most
+  std::vector<completionQueue::completion> done {};
+  completions.waitAndDrain(done, deferredTime + 200ms);
 
-  // dont loop forever, just some more time after the time-out
-  for (auto i {1}; i <= 200 && false == dts.isRun(threadState); ++i)
-  {
-    std::tie(threadState, threadResult) = dts.wait_for(1ms);
-  }
+  auto [threadState, threadResult] = dts.wait_for(200ms);
 
   if ( !dts.isRun(threadState) )
   {
@@ -0,0 +1,460 @@
+/*
+ * File:   executor.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 10:20 AM
+ */
+#include "executor.h"
+#include <iostream>
+#include <algorithm>
+#include <random>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+namespace
+{
+// the pool and the index of the worker running on this thread, if any
+thread_local const workStealingPool* currentPool_ {nullptr};
+thread_local std::size_t currentWorker_ {0};
+}  // namespace
+
+executor::~executor() noexcept
+{}
+
+void
+executor::post(executorTask&& task, const priority) noexcept(false)
+{
+  post(std::move(task));
+}
+
+void
+priorityExecutor::retarget(executor& target, const priority p) noexcept
+{
+  target_ = &target;
+  priority_ = p;
+}
+
+void
+priorityExecutor::post(executorTask&& task) noexcept(false)
+{
+  target_->post(std::move(task), priority_);
+}
+
+threadPerTaskExecutor&
+threadPerTaskExecutor::defaultExecutor() noexcept
+{
+  static threadPerTaskExecutor ex {};
+  return ex;
+}
+
+void
+threadPerTaskExecutor::post(executorTask&& task) noexcept(false)
+{
+  std::thread(std::move(task)).detach();
+}
+
+std::size_t
+workerPool::defaultNumWorkers() noexcept
+{
+  return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+workerPool::workerPool(const std::size_t numWorkers,
+                       const std::vector<cpuSet>& affinity) noexcept(false)
+{
+  auto n = std::max<std::size_t>(1, numWorkers);
+
+  workers_.reserve(n);
+  try
+  {
+    for (std::size_t i {}; i < n; ++i)
+    {
+      workers_.emplace_back([this, cpus = affinity.empty() ? cpuSet {} : affinity[i % affinity.size()]] ()
+                            {
+                              if ( false == cpus.empty() )
+                              {
+                                pinThisThread(cpus);
+                              }
+                              workerLoop();
+                            });
+    }
+  }
+  catch (...)
+  {
+    // no dtor runs: the workers already started must not outlive the pool
+    stopAndJoin();
+    throw;
+  }
+}
+
+workerPool::~workerPool() noexcept
+{
+  stopAndJoin();
+}
+
+void
+workerPool::stopAndJoin() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+workerPool&
+workerPool::defaultWorkerPool() noexcept
+{
+  static workerPool wp {};
+  return wp;
+}
+
+void
+workerPool::post(executorTask&& task) noexcept(false)
+{
+  post(std::move(task), defaultPriority);
+}
+
+void
+workerPool::post(executorTask&& task, const priority p) noexcept(false)
+{
+  auto posted = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    tasks_[std::min(p, lowestPriority)].push_back({std::move(task), posted});
+    ++queued_;
+  }
+  cv_.notify_one();
+}
+
+std::size_t
+workerPool::numWorkers() const noexcept
+{
+  return workers_.size();
+}
+
+std::size_t
+workerPool::queuedTasks() const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  return queued_;
+}
+
+std::size_t
+workerPool::queuedTasks(const priority p) const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  return tasks_[std::min(p, lowestPriority)].size();
+}
+
+workerPool::queueingStats
+workerPool::queueingDelay(const priority p) const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  auto i = std::min(p, lowestPriority);
+  auto stats {stats_[i]};
+
+  if ( stats.tasks > 0 )
+  {
+    stats.mean = totalDelay_[i] / stats.tasks;
+  }
+  return stats;
+}
+
+void
+workerPool::resetQueueingDelay() noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+
+  stats_.fill({});
+  totalDelay_.fill(std::chrono::nanoseconds::zero());
+}
+
+void
+workerPool::workerLoop() noexcept
+{
+  for (;;)
+  {
+    executorTask task {};
+    {
+      std::unique_lock<std::mutex> lk(mx_);
+      cv_.wait(lk, [this] () { return stop_ || (queued_ > 0); });
+      if ( 0 == queued_ )
+      {
+        // stop_ is set and nothing is left to run
+        return;
+      }
+      auto p = static_cast<std::size_t>(std::find_if(tasks_.begin(),
+                                                     tasks_.end(),
+                                                     [] (const auto& q) { return false == q.empty(); }) - tasks_.begin());
+      auto& q {tasks_[p]};
+      auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - q.front().posted);
+
+      task = std::move(q.front().task);
+      q.pop_front();
+      --queued_;
+      ++stats_[p].tasks;
+      totalDelay_[p] += delay;
+      stats_[p].max = std::max(stats_[p].max, delay);
+    }
+    try
+    {
+      task();
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "[" << __func__ << "] "
+                << "task terminated by exception: "
+                << e.what()
+                << std::endl;
+    }
+  }
+}
+
+workStealingPool::workStealingPool(const std::size_t numWorkers,
+                                   const std::vector<cpuSet>& affinity) noexcept(false)
+{
+  auto n = std::max<std::size_t>(1, numWorkers);
+
+  workers_.resize(n);
+  threads_.reserve(n);
+  try
+  {
+    for (std::size_t i {}; i < n; ++i)
+    {
+      threads_.emplace_back([this, i, cpus = affinity.empty() ? cpuSet {} : affinity[i % affinity.size()]] ()
+                            {
+                              if ( false == cpus.empty() )
+                              {
+                                pinThisThread(cpus);
+                              }
+                              // allocated and first touched by the worker
+                              // itself, on its NUMA node
+                              auto w = std::make_unique<worker>();
+                              {
+                                std::unique_lock<std::mutex> lk(mx_);
+                                workers_[i] = std::move(w);
+                                ++started_;
+                                cv_.notify_all();
+                                // all the workers exist before any of them
+                                // looks for a victim
+                                cv_.wait(lk, [this] () { return (workers_.size() == started_) || stop_.load(); });
+                                if ( workers_.size() != started_ )
+                                {
+                                  // a worker could not be started
+                                  return;
+                                }
+                              }
+                              workerLoop(i);
+                            });
+    }
+  }
+  catch (...)
+  {
+    // no dtor runs: the workers already started must not outlive the pool
+    stopAndJoin();
+    throw;
+  }
+
+  std::unique_lock<std::mutex> lk(mx_);
+  cv_.wait(lk, [this] () { return workers_.size() == started_; });
+}
+
+workStealingPool::~workStealingPool() noexcept
+{
+  stopAndJoin();
+}
+
+void
+workStealingPool::stopAndJoin() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    stop_.store(true);
+  }
+  cv_.notify_all();
+  for (auto& t : threads_)
+  {
+    t.join();
+  }
+}
+
+void
+workStealingPool::post(executorTask&& task) noexcept(false)
+{
+  auto t = std::make_unique<executorTask>(std::move(task));
+
+  // counted before being pushed, so that no worker ever sees a task taken
+  // but not counted; a worker going to sleep counts itself as a sleeper
+  // before checking pending_: either it sees this task or this sees it
+  pending_.fetch_add(1);
+  try
+  {
+    if ( this == currentPool_ )
+    {
+      workers_[currentWorker_]->deque.push(t.get());
+    }
+    else
+    {
+      auto& w {*workers_[nextInbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size()]};
+
+      std::lock_guard<std::mutex> lg(w.inboxMx);
+      w.inbox.push_back(t.get());
+    }
+    t.release();
+  }
+  catch (...)
+  {
+    pending_.fetch_sub(1);
+    throw;
+  }
+  if ( sleepers_.load() > 0 )
+  {
+    wakeOne();
+  }
+}
+
+std::size_t
+workStealingPool::numWorkers() const noexcept
+{
+  return workers_.size();
+}
+
+std::uint64_t
+workStealingPool::steals() const noexcept
+{
+  return steals_.load();
+}
+
+void
+workStealingPool::wakeOne() noexcept
+{
+  {
+    // so that the notification cannot fall between the check and the wait
+    // of a worker going to sleep
+    std::lock_guard<std::mutex> lg(mx_);
+    ++wakeUps_;
+  }
+  cv_.notify_one();
+}
+
+executorTask*
+workStealingPool::take(const std::size_t id, const std::size_t victim) noexcept
+{
+  auto& self {*workers_[id]};
+
+  if ( auto t = self.deque.pop();
+       nullptr != t )
+  {
+    return t;
+  }
+  {
+    std::lock_guard<std::mutex> lg(self.inboxMx);
+    if ( false == self.inbox.empty() )
+    {
+      auto t = self.inbox.front();
+      self.inbox.pop_front();
+      return t;
+    }
+  }
+  for (std::size_t k {}; k < workers_.size(); ++k)
+  {
+    auto v = (victim + k) % workers_.size();
+    if ( id == v )
+    {
+      continue;
+    }
+
+    auto& w {*workers_[v]};
+    auto t = w.deque.steal();
+    if ( (nullptr == t) && w.inboxMx.try_lock() )
+    {
+      if ( false == w.inbox.empty() )
+      {
+        t = w.inbox.front();
+        w.inbox.pop_front();
+      }
+      w.inboxMx.unlock();
+    }
+    if ( nullptr != t )
+    {
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return t;
+    }
+  }
+  return nullptr;
+}
+
+void
+workStealingPool::workerLoop(const std::size_t id) noexcept
+{
+  std::minstd_rand rng {static_cast<std::minstd_rand::result_type>(id + 1)};
+  std::uniform_int_distribution<std::size_t> victims {0, workers_.size() - 1};
+
+  std::size_t yields {0};
+
+  currentPool_ = this;
+  currentWorker_ = id;
+  for (;;)
+  {
+    if ( auto t = take(id, victims(rng));
+         nullptr != t )
+    {
+      pending_.fetch_sub(1);
+      try
+      {
+        (*t)();
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << "[" << __func__ << "] "
+                  << "task terminated by exception: "
+                  << e.what()
+                  << std::endl;
+      }
+      delete t;
+      yields = 0;
+      continue;
+    }
+    if ( pending_.load() > 0 )
+    {
+      // a task is being pushed or taken by another worker right now
+      if ( ++yields < maxYields )
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      // still not found: sleep until the next post, or a short while
+      yields = 0;
+      std::unique_lock<std::mutex> lk(mx_);
+      sleepers_.fetch_add(1);
+      cv_.wait_for(lk,
+                   pendingRetry,
+                   [this, w = wakeUps_] () { return stop_.load() || (w != wakeUps_); });
+      sleepers_.fetch_sub(1);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lk(mx_);
+    sleepers_.fetch_add(1);
+    cv_.wait(lk, [this] () { return stop_.load() || (pending_.load() > 0); });
+    sleepers_.fetch_sub(1);
+    if ( stop_.load() && (0 == pending_.load()) )
+    {
+      // nothing is left to run
+      return;
+    }
+  }
+}
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
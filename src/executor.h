@@ -0,0 +1,267 @@
+/*
+ * File:   executor.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 10:20 AM
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "workStealingDeque.h"
+#include "cpuAffinity.h"
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+using executorTask = std::function<void()>;
+
+// where the deferred tasks are run when their timers expire
+class executor
+{
+ public:
+  // the priority of a task: 0 is the highest, and the tasks posted without a
+  // priority have it
+  using priority = std::size_t;
+  static constexpr std::size_t numPriorities {8};
+  static constexpr priority highestPriority {0};
+  static constexpr priority lowestPriority {numPriorities - 1};
+  static constexpr priority defaultPriority {highestPriority};
+
+  executor() = default;
+  executor(const executor& rhs) = delete;
+  executor& operator=(const executor& rhs) = delete;
+  executor(executor&& rhs) = delete;
+  executor& operator=(executor&& rhs) = delete;
+
+  virtual ~executor() noexcept;
+
+  virtual
+  void
+  post(executorTask&& task) noexcept(false) = 0;
+
+  // post task at priority p, a higher priority task being started first when
+  // the executor is saturated; executors running every task at once ignore p
+  virtual
+  void
+  post(executorTask&& task, const priority p) noexcept(false);
+};  // class executor
+
+// posts to an executor at a fixed priority: what an instance with a priority
+// hands to the timer service as its executor
+class priorityExecutor final : public executor
+{
+ public:
+  priorityExecutor() = default;
+  priorityExecutor(const priorityExecutor& rhs) = delete;
+  priorityExecutor& operator=(const priorityExecutor& rhs) = delete;
+  priorityExecutor(priorityExecutor&& rhs) = delete;
+  priorityExecutor& operator=(priorityExecutor&& rhs) = delete;
+
+  void
+  retarget(executor& target, const priority p) noexcept;
+
+  void
+  post(executorTask&& task) noexcept(false) override;
+
+  using executor::post;
+
+ private:
+  executor* target_ {nullptr};
+  priority priority_ {defaultPriority};
+};  // class priorityExecutor
+
+// run every task on a new detached thread
+class threadPerTaskExecutor final : public executor
+{
+ public:
+  threadPerTaskExecutor() = default;
+
+  static
+  threadPerTaskExecutor&
+  defaultExecutor() noexcept;
+
+  void
+  post(executorTask&& task) noexcept(false) override;
+
+  using executor::post;
+};  // class threadPerTaskExecutor
+
+// a fixed number of worker threads running the tasks in FIFO order, so that a
+// burst of tasks due at the same instant does not oversubscribe the machine;
+// when the tasks queue up, a free worker takes the oldest task of the highest
+// priority, so that critical tasks do not wait behind bulk ones
+class workerPool final : public executor
+{
+ public:
+  // the hardware concurrency, or 1 if it is not computable
+  static
+  std::size_t
+  defaultNumWorkers() noexcept;
+
+  // worker i is pinned to the CPUs affinity[i % affinity.size()], if any
+  explicit
+  workerPool(const std::size_t numWorkers = defaultNumWorkers(),
+             const std::vector<cpuSet>& affinity = {}) noexcept(false);
+
+  // the tasks already posted are run before the workers are joined
+  ~workerPool() noexcept override;
+
+  // the worker pool sized to the hardware concurrency
+  static
+  workerPool&
+  defaultWorkerPool() noexcept;
+
+  void
+  post(executorTask&& task) noexcept(false) override;
+
+  void
+  post(executorTask&& task, const priority p) noexcept(false) override;
+
+  std::size_t
+  numWorkers() const noexcept;
+
+  std::size_t
+  queuedTasks() const noexcept;
+
+  std::size_t
+  queuedTasks(const priority p) const noexcept;
+
+  // how long the tasks of a priority waited in the queue: from being posted
+  // to being taken by a worker
+  struct queueingStats
+  {
+    std::uint64_t tasks {0};
+    std::chrono::nanoseconds mean {0};
+    std::chrono::nanoseconds max {0};
+  };
+
+  queueingStats
+  queueingDelay(const priority p) const noexcept;
+
+  void
+  resetQueueingDelay() noexcept;
+
+ private:
+  struct queuedTask
+  {
+    executorTask task {};
+    std::chrono::steady_clock::time_point posted {};
+  };
+
+  mutable std::mutex mx_ {};
+  std::condition_variable cv_ {};
+  // one FIFO queue per priority
+  std::array<std::deque<queuedTask>, numPriorities> tasks_ {};
+  std::size_t queued_ {0};
+  std::array<queueingStats, numPriorities> stats_ {};
+  std::array<std::chrono::nanoseconds, numPriorities> totalDelay_ {};
+  bool stop_ {false};
+  std::vector<std::thread> workers_ {};
+
+  void
+  workerLoop() noexcept;
+
+  // the workers started, if any, run the tasks queued and terminate
+  void
+  stopAndJoin() noexcept;
+};  // class workerPool
+
+// a fixed number of worker threads, each with a Chase-Lev deque of its own
+// instead of a queue shared by all: a task posted by a worker, e.g. a follow-up
+// task, is pushed to the deque of that worker and popped back by it with no
+// lock; the tasks posted by the other threads, e.g. the timer thread, are
+// spread over the inboxes of the workers, so that no lock is shared by all the
+// posts; a worker with nothing left steals the oldest task of a worker chosen
+// at random.
+// The workers run the tasks in no particular order, and ignore the
+// priorities: a workerPool serves those
+class workStealingPool final : public executor
+{
+ public:
+  // worker i is pinned to the CPUs affinity[i % affinity.size()], if any;
+  // each worker allocates its own deque and inbox once pinned, so that they
+  // land on the NUMA node of the worker; the tasks are allocated by the
+  // threads posting them, wherever they run
+  explicit
+  workStealingPool(const std::size_t numWorkers = workerPool::defaultNumWorkers(),
+                   const std::vector<cpuSet>& affinity = {}) noexcept(false);
+
+  // the tasks already posted are run before the workers are joined
+  ~workStealingPool() noexcept override;
+
+  void
+  post(executorTask&& task) noexcept(false) override;
+
+  using executor::post;
+
+  std::size_t
+  numWorkers() const noexcept;
+
+  // the tasks taken by a worker from the deque or the inbox of another one
+  std::uint64_t
+  steals() const noexcept;
+
+ private:
+  struct worker
+  {
+    workStealingDeque<executorTask> deque {};
+    // the tasks posted by the threads that are not workers of this pool
+    std::mutex inboxMx {};
+    std::deque<executorTask*> inbox {};
+  };
+
+  std::vector<std::unique_ptr<worker>> workers_ {};
+  std::vector<std::thread> threads_ {};
+  // the workers that have allocated their state
+  std::size_t started_ {0};
+  std::atomic<std::size_t> nextInbox_ {0};
+  // the tasks posted and not taken yet: the workers sleep only when it is 0
+  std::atomic<std::size_t> pending_ {0};
+  std::atomic<std::size_t> sleepers_ {0};
+  std::atomic<std::uint64_t> steals_ {0};
+  std::atomic<bool> stop_ {false};
+  std::mutex mx_ {};
+  std::condition_variable cv_ {};
+  // the notifications of sleepers, guarded by mx_
+  std::uint64_t wakeUps_ {0};
+
+  // a worker finding no task while some are pending yields maxYields times,
+  // then sleeps until the next post, at most pendingRetry
+  static constexpr std::size_t maxYields {64};
+  static constexpr std::chrono::microseconds pendingRetry {100};
+
+  void
+  workerLoop(const std::size_t id) noexcept;
+
+  // the workers started, if any, run the tasks posted and terminate
+  void
+  stopAndJoin() noexcept;
+
+  // a task of worker id, from its deque or its inbox, else stolen from
+  // another worker starting from victim; nullptr if none is found
+  executorTask*
+  take(const std::size_t id, const std::size_t victim) noexcept;
+
+  void
+  wakeOne() noexcept;
+};  // class workStealingPool
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
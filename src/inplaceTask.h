@@ -0,0 +1,249 @@
+/*
+ * File:   inplaceTask.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 4:30 PM
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <functional>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+template <typename Signature, std::size_t Capacity = 64>
+class inplaceTask;
+
+// A move-only callable wrapper, like std::function but not copyable: a
+// callable of up to Capacity bytes, nothrow move constructible and not over
+// aligned, is stored inside the object and costs no heap allocation; a larger
+// one is moved to the heap.
+// Being move-only, it can hold callables capturing move-only objects.
+template <typename R, typename... Args, std::size_t Capacity>
+class inplaceTask<R(Args...), Capacity> final
+{
+ public:
+  static constexpr std::size_t capacity {Capacity};
+
+  // whether a callable of type T is stored inside the object
+  template <typename T>
+  static constexpr bool isStoredInline {(sizeof(T) <= Capacity) &&
+                                        (alignof(T) <= alignof(std::max_align_t)) &&
+                                        std::is_nothrow_move_constructible_v<T>};
+
+  inplaceTask() = default;
+  inplaceTask(const inplaceTask& rhs) = delete;
+  inplaceTask& operator=(const inplaceTask& rhs) = delete;
+
+  inplaceTask(inplaceTask&& rhs) noexcept
+  {
+    moveFrom(rhs);
+  }
+
+  inplaceTask&
+  operator=(inplaceTask&& rhs) noexcept
+  {
+    if ( this != &rhs )
+    {
+      reset();
+      moveFrom(rhs);
+    }
+    return *this;
+  }
+
+  template <typename T,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, inplaceTask>>>
+  inplaceTask(T&& callable) noexcept(false)
+  {
+    emplace(std::forward<T>(callable));
+  }
+
+  template <typename T,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, inplaceTask>>>
+  inplaceTask&
+  operator=(T&& callable) noexcept(false)
+  {
+    reset();
+    emplace(std::forward<T>(callable));
+    return *this;
+  }
+
+  ~inplaceTask() noexcept
+  {
+    reset();
+  }
+
+  explicit
+  operator bool() const noexcept
+  {
+    return nullptr != ops_;
+  }
+
+  // whether the callable held, if any, is stored inside the object
+  bool
+  isInline() const noexcept
+  {
+    return (nullptr != ops_) && ops_->isInline;
+  }
+
+  R
+  operator()(Args... args) noexcept(false)
+  {
+    if ( nullptr == ops_ )
+    {
+      throw std::bad_function_call();
+    }
+    return ops_->invoke(storage_, std::forward<Args>(args)...);
+  }
+
+  void
+  reset() noexcept
+  {
+    if ( nullptr != ops_ )
+    {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  using storage = std::aligned_storage_t<Capacity, alignof(std::max_align_t)>;
+
+  // the operations on the callable type held, one static table per type
+  struct operations
+  {
+    R (*invoke)(storage&, Args&&...);
+    // move constructs dst from src, then destroys src
+    void (*relocate)(storage& dst, storage& src) noexcept;
+    void (*destroy)(storage&) noexcept;
+    bool isInline;
+  };
+
+  template <typename T>
+  struct inlineOperations
+  {
+    static
+    T&
+    get(storage& s) noexcept
+    {
+      return *std::launder(reinterpret_cast<T*>(&s));
+    }
+
+    static
+    R
+    invoke(storage& s, Args&&... args)
+    {
+      if constexpr ( std::is_void_v<R> )
+      {
+        std::invoke(get(s), std::forward<Args>(args)...);
+      }
+      else
+      {
+        return std::invoke(get(s), std::forward<Args>(args)...);
+      }
+    }
+
+    static
+    void
+    relocate(storage& dst, storage& src) noexcept
+    {
+      ::new (static_cast<void*>(&dst)) T(std::move(get(src)));
+      get(src).~T();
+    }
+
+    static
+    void
+    destroy(storage& s) noexcept
+    {
+      get(s).~T();
+    }
+
+    static constexpr operations table {&invoke, &relocate, &destroy, true};
+  };
+
+  template <typename T>
+  struct heapOperations
+  {
+    static
+    T*&
+    get(storage& s) noexcept
+    {
+      return *std::launder(reinterpret_cast<T**>(&s));
+    }
+
+    static
+    R
+    invoke(storage& s, Args&&... args)
+    {
+      if constexpr ( std::is_void_v<R> )
+      {
+        std::invoke(*get(s), std::forward<Args>(args)...);
+      }
+      else
+      {
+        return std::invoke(*get(s), std::forward<Args>(args)...);
+      }
+    }
+
+    static
+    void
+    relocate(storage& dst, storage& src) noexcept
+    {
+      ::new (static_cast<void*>(&dst)) T*(get(src));
+    }
+
+    static
+    void
+    destroy(storage& s) noexcept
+    {
+      delete get(s);
+    }
+
+    static constexpr operations table {&invoke, &relocate, &destroy, false};
+  };
+
+  storage storage_ {};
+  const operations* ops_ {nullptr};
+
+  template <typename T>
+  void
+  emplace(T&& callable) noexcept(false)
+  {
+    using callableType = std::decay_t<T>;
+
+    static_assert(std::is_invocable_r_v<R, callableType&, Args...>,
+                  "The callable must be invocable with the signature of the task");
+    if constexpr ( isStoredInline<callableType> )
+    {
+      ::new (static_cast<void*>(&storage_)) callableType(std::forward<T>(callable));
+      ops_ = &inlineOperations<callableType>::table;
+    }
+    else
+    {
+      ::new (static_cast<void*>(&storage_)) callableType*(new callableType(std::forward<T>(callable)));
+      ops_ = &heapOperations<callableType>::table;
+    }
+  }
+
+  void
+  moveFrom(inplaceTask& rhs) noexcept
+  {
+    if ( nullptr != rhs.ops_ )
+    {
+      rhs.ops_->relocate(storage_, rhs.storage_);
+      ops_ = rhs.ops_;
+      rhs.ops_ = nullptr;
+    }
+  }
+};  // class inplaceTask
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
@@ -0,0 +1,338 @@
+/*
+ * File:   taskGraph.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 8:15 PM
+ */
+#include "taskGraph.h"
+#include <exception>
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+taskGraph::taskGraph(timerService& ts, executor* ex) noexcept
+:
+timerService_ (ts),
+executor_ ((nullptr == ex) ? ts.getExecutor() : *ex)
+{}
+
+taskGraph::~taskGraph() noexcept
+{
+  cancelAll();
+  // a graph not started has no job in flight
+  std::unique_lock<std::mutex> lk(mx_);
+  cv_.wait(lk, [this] () { return 0 == inFlight_.load(); });
+}
+
+taskGraph::nodeId
+taskGraph::addNode(executorTask&& job, const timerDeadline deadline) noexcept(false)
+{
+  if ( started_ )
+  {
+    return invalidNodeId;
+  }
+  nodes_.push_back(std::make_unique<node>());
+  nodes_.back()->job = std::move(job);
+  nodes_.back()->deadline = deadline;
+  ++unterminated_;
+  return nodes_.size() - 1;
+}
+
+bool
+taskGraph::addDependency(const nodeId before, const nodeId after) noexcept(false)
+{
+  if ( started_ || (before >= nodes_.size()) || (after >= nodes_.size()) || (before == after) )
+  {
+    return false;
+  }
+  nodes_[before]->dependents.push_back(after);
+  ++nodes_[after]->predecessors;
+  return true;
+}
+
+bool
+taskGraph::start() noexcept(false)
+{
+  if ( started_ )
+  {
+    return false;
+  }
+
+  // Kahn's algorithm: the graph has no cycle if all the nodes can be sorted
+  std::vector<std::size_t> predecessors (nodes_.size());
+  std::vector<nodeId> sorted {};
+  sorted.reserve(nodes_.size());
+  for (nodeId id {}; id < nodes_.size(); ++id)
+  {
+    predecessors[id] = nodes_[id]->predecessors;
+    if ( 0 == predecessors[id] )
+    {
+      sorted.push_back(id);
+    }
+  }
+  for (std::size_t i {}; i < sorted.size(); ++i)
+  {
+    for (auto dependent : nodes_[sorted[i]]->dependents)
+    {
+      if ( 0 == --predecessors[dependent] )
+      {
+        sorted.push_back(dependent);
+      }
+    }
+  }
+  if ( sorted.size() != nodes_.size() )
+  {
+    return false;
+  }
+
+  started_ = true;
+  // all the counts are set before any node can be released
+  for (auto& n : nodes_)
+  {
+    n->waitingFor.store(n->predecessors + 1);
+  }
+
+  auto now = timerClock::now();
+  for (nodeId id {}; id < nodes_.size(); ++id)
+  {
+    auto& n = *nodes_[id];
+
+    if ( nodeState::Pending != n.state.load() )
+    {
+      // canceled before start()
+      continue;
+    }
+    if ( n.deadline <= now )
+    {
+      release(id, false);
+      continue;
+    }
+    // the timer job runs the node inline if the deadline is the last thing it
+    // waits for: it already runs on the executor
+    ++inFlight_;
+    try
+    {
+      n.timerId.store(timerService_.schedule(n.deadline,
+                                             [this, id] ()
+                                             {
+                                               release(id, true);
+                                               jobDone();
+                                             },
+                                             &executor_));
+    }
+    catch (...)
+    {
+      // as if the node was canceled: wait() must not wait for its timer
+      jobDone();
+      cancelFrom(id);
+      continue;
+    }
+    // a cancelFrom() that won the transition from Pending before the store
+    // found no timer to remove: remove it here; the sequentially consistent
+    // store and load pair with the transition and the load of the id in
+    // cancelFrom(), so that at least one of them sees the other, and the one
+    // that removes the timer accounts for its job
+    if ( nodeState::Canceled == n.state.load() )
+    {
+      cancelTimer(id);
+    }
+  }
+  return true;
+}
+
+bool
+taskGraph::cancel(const nodeId id) noexcept
+{
+  if ( id >= nodes_.size() )
+  {
+    return false;
+  }
+  return cancelFrom(id);
+}
+
+void
+taskGraph::cancelAll() noexcept
+{
+  for (nodeId id {}; id < nodes_.size(); ++id)
+  {
+    cancelFrom(id);
+  }
+}
+
+void
+taskGraph::wait() const noexcept
+{
+  // the nodes of a graph not started do not terminate by themselves
+  if ( false == started_.load() )
+  {
+    return;
+  }
+  std::unique_lock<std::mutex> lk(mx_);
+  cv_.wait(lk, [this] () { return (0 == unterminated_.load()) && (0 == inFlight_.load()); });
+}
+
+taskGraph::nodeState
+taskGraph::getNodeState(const nodeId id) const noexcept
+{
+  return nodes_[id]->state.load();
+}
+
+std::string
+taskGraph::getExceptionThrownMessage(const nodeId id) const noexcept
+{
+  return nodes_[id]->exceptionThrownMessage;
+}
+
+std::size_t
+taskGraph::size() const noexcept
+{
+  return nodes_.size();
+}
+
+void
+taskGraph::release(const nodeId id, const bool runInline) noexcept
+{
+  auto& n = *nodes_[id];
+
+  if ( 1 != n.waitingFor.fetch_sub(1) )
+  {
+    return;
+  }
+  // either this or cancel() wins the transition from Pending
+  auto pending {nodeState::Pending};
+  if ( false == n.state.compare_exchange_strong(pending, nodeState::Ready) )
+  {
+    return;
+  }
+  if ( runInline )
+  {
+    run(id);
+    return;
+  }
+  post(id);
+}
+
+void
+taskGraph::run(const nodeId id) noexcept
+{
+  auto& n = *nodes_[id];
+
+  // either this or cancel() wins the transition from Ready
+  if ( auto ready {nodeState::Ready};
+       false == n.state.compare_exchange_strong(ready, nodeState::Running) )
+  {
+    return;
+  }
+  try
+  {
+    n.job();
+  }
+  catch (const std::exception& e)
+  {
+    n.exceptionThrownMessage = e.what();
+    terminate(id, nodeState::ExceptionThrown);
+    return;
+  }
+  catch (...)
+  {
+    terminate(id, nodeState::ExceptionThrown);
+    return;
+  }
+  terminate(id, nodeState::Run);
+}
+
+void
+taskGraph::terminate(const nodeId id, const nodeState state) noexcept
+{
+  auto& n = *nodes_[id];
+
+  n.state.store(state);
+  for (auto dependent : n.dependents)
+  {
+    if ( nodeState::Run == state )
+    {
+      release(dependent, false);
+    }
+    else
+    {
+      cancelFrom(dependent);
+    }
+  }
+  nodeTerminated();
+}
+
+bool
+taskGraph::cancelFrom(const nodeId id) noexcept
+{
+  auto& n = *nodes_[id];
+  auto s = n.state.load();
+
+  do
+  {
+    if ( (nodeState::Pending != s) && (nodeState::Ready != s) )
+    {
+      return false;
+    }
+    // on failure s is reloaded with the state set by the running thread
+  } while ( false == n.state.compare_exchange_weak(s, nodeState::Canceled) );
+
+  cancelTimer(id);
+  for (auto dependent : n.dependents)
+  {
+    cancelFrom(dependent);
+  }
+  nodeTerminated();
+  return true;
+}
+
+void
+taskGraph::cancelTimer(const nodeId id) noexcept
+{
+  // the job of a timer removed before it fired is never run
+  if ( auto timerId {nodes_[id]->timerId.load()};
+       (timerService::invalidTimerId != timerId) && timerService_.cancel(timerId) )
+  {
+    jobDone();
+  }
+}
+
+void
+taskGraph::post(const nodeId id) noexcept
+{
+  ++inFlight_;
+  try
+  {
+    executor_.post([this, id] ()
+                   {
+                     run(id);
+                     jobDone();
+                   });
+  }
+  catch (...)
+  {
+    jobDone();
+    cancelFrom(id);
+  }
+}
+
+void
+taskGraph::jobDone() noexcept
+{
+  // the waiter cannot return, and destroy the graph, before the lock is
+  // released
+  std::lock_guard<std::mutex> lg(mx_);
+  if ( 1 == inFlight_.fetch_sub(1) )
+  {
+    cv_.notify_all();
+  }
+}
+
+void
+taskGraph::nodeTerminated() noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  if ( 1 == unterminated_.fetch_sub(1) )
+  {
+    cv_.notify_all();
+  }
+}
+}  // namespace DTS
@@ -0,0 +1,163 @@
+/*
+ * File:   taskGraph.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 8:15 PM
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include "timerService.h"
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+// A graph of deferred tasks: a node runs when its deadline has passed and all
+// the nodes it depends on have run.
+// Every node counts what it still waits for: its predecessors plus its
+// deadline. The timer of the deadline and each predecessor completing take one
+// off the count, and whoever takes the last one posts the node to the executor:
+// nothing polls. Canceling a node, or a node throwing, cancels all the nodes
+// depending on it.
+// The nodes and their dependencies are added before start().
+class taskGraph final
+{
+ public:
+  using nodeId = std::size_t;
+  static constexpr nodeId invalidNodeId {static_cast<nodeId>(-1)};
+
+  enum class nodeState : int
+  {
+    Pending,
+    Ready,
+    Running,
+    Run,
+    Canceled,
+    ExceptionThrown
+  };
+
+  taskGraph(const taskGraph& rhs) = delete;
+  taskGraph& operator=(const taskGraph& rhs) = delete;
+  taskGraph(taskGraph&& rhs) = delete;
+  taskGraph& operator=(taskGraph&& rhs) = delete;
+
+  // the deadlines are armed in ts and the nodes run on ex, or on the executor
+  // of ts if ex is nullptr
+  explicit
+  taskGraph(timerService& ts = timerService::defaultTimerService(),
+            executor* ex = nullptr) noexcept;
+
+  // the nodes not run yet are canceled, and the running ones waited for
+  ~taskGraph() noexcept;
+
+  // a node running job not before deadline; with no deadline it runs as soon
+  // as its predecessors have run; invalidNodeId if the graph is started
+  nodeId
+  addNode(executorTask&& job, const timerDeadline deadline = timerDeadline {}) noexcept(false);
+
+  // after runs only after before has run; false if the graph is started or a
+  // node is unknown
+  bool
+  addDependency(const nodeId before, const nodeId after) noexcept(false);
+
+  // arm the deadlines and run the nodes ready; false, starting nothing, if the
+  // dependencies have a cycle or the graph was already started; a node whose
+  // deadline cannot be armed is canceled, with its dependents
+  bool
+  start() noexcept(false);
+
+  // cancel a node not running yet and, transitively, the nodes depending on
+  // it; false if the node is already running or terminated
+  bool
+  cancel(const nodeId id) noexcept;
+
+  // cancel all the nodes not running yet
+  void
+  cancelAll() noexcept;
+
+  // block until every node has run or has been canceled; return at once if
+  // the graph is not started
+  void
+  wait() const noexcept;
+
+  nodeState
+  getNodeState(const nodeId id) const noexcept;
+
+  // the message of the exception thrown by a node
+  std::string
+  getExceptionThrownMessage(const nodeId id) const noexcept;
+
+  std::size_t
+  size() const noexcept;
+
+ private:
+  struct node
+  {
+    executorTask job {};
+    timerDeadline deadline {};
+    std::vector<nodeId> dependents {};
+    std::size_t predecessors {0};
+    // the predecessors not run yet, plus one until the deadline is reached
+    std::atomic<std::size_t> waitingFor {0};
+    std::atomic<nodeState> state {nodeState::Pending};
+    std::atomic<timerService::timerId> timerId {timerService::invalidTimerId};
+    std::string exceptionThrownMessage {};
+  };
+
+  timerService& timerService_;
+  executor& executor_;
+  std::vector<std::unique_ptr<node>> nodes_ {};
+  std::atomic<bool> started_ {false};
+
+  // the nodes not terminated yet, and the jobs posted or armed that still
+  // reference this graph: wait() and the dtor return when both are zero
+  std::atomic<std::size_t> unterminated_ {0};
+  std::atomic<std::size_t> inFlight_ {0};
+  mutable std::mutex mx_ {};
+  mutable std::condition_variable cv_ {};
+
+  // take one off what id waits for; the last one makes it ready and runs it,
+  // inline if runInline, else on the executor
+  void
+  release(const nodeId id, const bool runInline) noexcept;
+
+  void
+  run(const nodeId id) noexcept;
+
+  // the last step of a node: terminated in state, its dependents are released
+  // or canceled
+  void
+  terminate(const nodeId id, const nodeState state) noexcept;
+
+  // cancel id, if it has not started, and its dependents; false if id has
+  // already started
+  bool
+  cancelFrom(const nodeId id) noexcept;
+
+  // remove the deadline timer of id, if armed and not fired yet
+  void
+  cancelTimer(const nodeId id) noexcept;
+
+  void
+  post(const nodeId id) noexcept;
+
+  void
+  jobDone() noexcept;
+
+  void
+  nodeTerminated() noexcept;
+};  // class taskGraph
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
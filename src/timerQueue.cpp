@@ -0,0 +1,471 @@
+/*
+ * File:   timerQueue.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 2:10 PM
+ */
+#include "timerQueue.h"
+#include <algorithm>
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+timerQueue::~timerQueue() noexcept
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+// orderedTimerQueue
+
+void
+orderedTimerQueue::push(const slotIndex slot, const timerDeadline deadline) noexcept(false)
+{
+  queue_.emplace(deadline, slot);
+}
+
+void
+orderedTimerQueue::erase(const slotIndex slot, const timerDeadline deadline) noexcept
+{
+  queue_.erase({deadline, slot});
+}
+
+timerDeadline
+orderedTimerQueue::nextDeadline() const noexcept
+{
+  return queue_.begin()->first;
+}
+
+void
+orderedTimerQueue::popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false)
+{
+  auto it = queue_.begin();
+  for (; (queue_.end() != it) && (it->first <= now); ++it)
+  {
+    expired.push_back(it->second);
+  }
+  queue_.erase(queue_.begin(), it);
+}
+
+std::size_t
+orderedTimerQueue::size() const noexcept
+{
+  return queue_.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// dAryHeapTimerQueue
+
+void
+dAryHeapTimerQueue::push(const slotIndex slot, const timerDeadline deadline) noexcept(false)
+{
+  if ( slot >= heapIndex_.size() )
+  {
+    heapIndex_.resize(slot + std::size_t {1});
+  }
+  heap_.push_back({deadline, slot});
+  siftUp(static_cast<heapIndex>(heap_.size() - 1));
+}
+
+void
+dAryHeapTimerQueue::erase(const slotIndex slot, const timerDeadline) noexcept
+{
+  removeAt(heapIndex_[slot]);
+}
+
+timerDeadline
+dAryHeapTimerQueue::nextDeadline() const noexcept
+{
+  return heap_.front().deadline;
+}
+
+void
+dAryHeapTimerQueue::popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false)
+{
+  while ( (false == heap_.empty()) && (heap_.front().deadline <= now) )
+  {
+    expired.push_back(heap_.front().slot);
+    removeAt(0);
+  }
+}
+
+std::size_t
+dAryHeapTimerQueue::size() const noexcept
+{
+  return heap_.size();
+}
+
+void
+dAryHeapTimerQueue::removeAt(const heapIndex i) noexcept
+{
+  auto last = static_cast<heapIndex>(heap_.size() - 1);
+
+  if ( i != last )
+  {
+    // the last entry fills the hole, then moves up or down to its place
+    auto deadline = heap_[i].deadline;
+
+    heap_[i] = heap_[last];
+    heapIndex_[heap_[i].slot] = i;
+    heap_.pop_back();
+    if ( heap_[i].deadline < deadline )
+    {
+      siftUp(i);
+    }
+    else
+    {
+      siftDown(i);
+    }
+    return;
+  }
+  heap_.pop_back();
+}
+
+void
+dAryHeapTimerQueue::siftUp(heapIndex i) noexcept
+{
+  auto entry = heap_[i];
+
+  while ( i > 0 )
+  {
+    auto parent = static_cast<heapIndex>((i - 1) / arity);
+    if ( false == (entry.deadline < heap_[parent].deadline) )
+    {
+      break;
+    }
+    heap_[i] = heap_[parent];
+    heapIndex_[heap_[i].slot] = i;
+    i = parent;
+  }
+  heap_[i] = entry;
+  heapIndex_[entry.slot] = i;
+}
+
+void
+dAryHeapTimerQueue::siftDown(heapIndex i) noexcept
+{
+  auto entry = heap_[i];
+  auto n = heap_.size();
+
+  for (;;)
+  {
+    auto first = arity * i + 1;
+    if ( first >= n )
+    {
+      break;
+    }
+    // the earliest of up to arity children, adjacent in memory
+    auto child = first;
+    for (auto c {first + 1}; c < std::min(first + arity, n); ++c)
+    {
+      if ( heap_[c].deadline < heap_[child].deadline )
+      {
+        child = c;
+      }
+    }
+    if ( false == (heap_[child].deadline < entry.deadline) )
+    {
+      break;
+    }
+    heap_[i] = heap_[child];
+    heapIndex_[heap_[i].slot] = i;
+    i = static_cast<heapIndex>(child);
+  }
+  heap_[i] = entry;
+  heapIndex_[entry.slot] = i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// timingWheelTimerQueue
+
+timingWheelTimerQueue::timingWheelTimerQueue(const tickDuration tick,
+                                             const timerDeadline origin) noexcept
+:
+tick_ (std::max(tick, tickDuration {1})),
+origin_ (origin)
+{
+  heads_.fill(noSlot);
+}
+
+void
+timingWheelTimerQueue::push(const slotIndex slot, const timerDeadline deadline) noexcept(false)
+{
+  if ( slot >= nodes_.size() )
+  {
+    nodes_.resize(slot + std::size_t {1});
+  }
+  if ( 0 == size_ )
+  {
+    // an empty wheel can jump ahead at no cost, and deadlines are then placed
+    // relative to the present rather than to the last timer expired
+    if ( auto now = timerClock::now();
+         now > origin_ )
+    {
+      currentTick_ = std::max(currentTick_, static_cast<tickCount>((now - origin_) / tick_));
+    }
+  }
+  nodes_[slot].expiry = toTicks(deadline);
+  place(slot);
+  ++size_;
+}
+
+void
+timingWheelTimerQueue::erase(const slotIndex slot, const timerDeadline) noexcept
+{
+  unlink(slot);
+  --size_;
+}
+
+timerDeadline
+timingWheelTimerQueue::nextDeadline() const noexcept
+{
+  if ( noSlot != heads_[dueList] )
+  {
+    return origin_ + tick_ * static_cast<tickDuration::rep>(currentTick_);
+  }
+  return origin_ + tick_ * static_cast<tickDuration::rep>(nextEventTick());
+}
+
+void
+timingWheelTimerQueue::popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false)
+{
+  auto drain = [this, &expired] (const listIndex list)
+               {
+                 for (auto slot = heads_[list]; noSlot != slot; slot = nodes_[slot].next)
+                 {
+                   expired.push_back(slot);
+                   --size_;
+                 }
+                 heads_[list] = noSlot;
+               };
+
+  if ( now < origin_ )
+  {
+    return;
+  }
+
+  auto target = static_cast<tickCount>((now - origin_) / tick_);
+
+  drain(dueList);
+  while ( currentTick_ < target )
+  {
+    if ( 0 == size_ )
+    {
+      // nothing to move down nor to expire up to target
+      currentTick_ = target;
+      break;
+    }
+
+    // jump to the next tick where something happens, on any level: the empty
+    // rotations in between are not walked through
+    auto next = nextEventTick();
+
+    if ( next > target )
+    {
+      currentTick_ = target;
+      break;
+    }
+    currentTick_ = next;
+    if ( 0 == (next & (numBuckets - 1)) )
+    {
+      constexpr tickCount overflowMask {(tickCount {1} << (levelBits * numLevels)) - 1};
+      if ( 0 == (next & overflowMask) )
+      {
+        cascade(numLevels);
+      }
+      for (auto level {numLevels - 1}; level > 0; --level)
+      {
+        if ( 0 == (next & ((tickCount {1} << (levelBits * level)) - 1)) )
+        {
+          cascade(level);
+        }
+      }
+    }
+    auto index = static_cast<std::size_t>(next & (numBuckets - 1));
+    setBucketBit(0, index, false);
+    drain(static_cast<listIndex>(index));
+    drain(dueList);
+  }
+}
+
+std::size_t
+timingWheelTimerQueue::size() const noexcept
+{
+  return size_;
+}
+
+timingWheelTimerQueue::tickCount
+timingWheelTimerQueue::nextEventTick() const noexcept
+{
+  auto best = std::numeric_limits<tickCount>::max();
+  for (std::size_t level {}; level < numLevels; ++level)
+  {
+    auto shift = levelBits * level;
+    auto unit = currentTick_ >> shift;
+    auto index = static_cast<std::size_t>(unit & (numBuckets - 1));
+    auto base = unit - index;
+
+    // a bucket ahead in the current rotation of the level is moved down when
+    // the wheel reaches it...
+    if ( auto next = nextBucket(level, index);
+         next < numBuckets )
+    {
+      best = std::min(best, (base + next) << shift);
+    }
+    // ...a bucket behind it only in the next rotation
+    if ( auto first = (0 != (bitmaps_[level][0] & 1u)) ? 0 : nextBucket(level, 0);
+         first <= index )
+    {
+      best = std::min(best, (base + numBuckets) << shift);
+    }
+  }
+  if ( noSlot != heads_[overflowList] )
+  {
+    auto shift = levelBits * numLevels;
+    best = std::min(best, ((currentTick_ >> shift) + 1) << shift);
+  }
+  return best;
+}
+
+timingWheelTimerQueue::tickCount
+timingWheelTimerQueue::toTicks(const timerDeadline deadline) const noexcept
+{
+  if ( deadline <= origin_ )
+  {
+    return 0;
+  }
+  // round up: a timer must never fire before its deadline
+  auto elapsed = std::chrono::ceil<tickDuration>(deadline - origin_);
+  return static_cast<tickCount>((elapsed + tick_ - tickDuration {1}) / tick_);
+}
+
+void
+timingWheelTimerQueue::place(const slotIndex slot) noexcept
+{
+  auto expiry = nodes_[slot].expiry;
+
+  if ( expiry <= currentTick_ )
+  {
+    link(slot, dueList);
+    return;
+  }
+
+  auto delta = expiry - currentTick_;
+  for (std::size_t level {}; level < numLevels; ++level)
+  {
+    auto shift = levelBits * level;
+    if ( delta < (tickCount {1} << (shift + levelBits)) )
+    {
+      auto index = static_cast<listIndex>((expiry >> shift) & (numBuckets - 1));
+      link(slot, static_cast<listIndex>(level * numBuckets) + index);
+      return;
+    }
+  }
+  link(slot, overflowList);
+}
+
+void
+timingWheelTimerQueue::link(const slotIndex slot, const listIndex list) noexcept
+{
+  auto& node = nodes_[slot];
+
+  node.list = list;
+  node.prev = noSlot;
+  node.next = heads_[list];
+  if ( noSlot != node.next )
+  {
+    nodes_[node.next].prev = slot;
+  }
+  heads_[list] = slot;
+  if ( list < dueList )
+  {
+    setBucketBit(list / numBuckets, list % numBuckets, true);
+  }
+}
+
+void
+timingWheelTimerQueue::unlink(const slotIndex slot) noexcept
+{
+  auto& node = nodes_[slot];
+
+  if ( noSlot != node.next )
+  {
+    nodes_[node.next].prev = node.prev;
+  }
+  if ( noSlot != node.prev )
+  {
+    nodes_[node.prev].next = node.next;
+  }
+  else
+  {
+    heads_[node.list] = node.next;
+    if ( (noSlot == node.next) && (node.list < dueList) )
+    {
+      setBucketBit(node.list / numBuckets, node.list % numBuckets, false);
+    }
+  }
+  node.prev = noSlot;
+  node.next = noSlot;
+}
+
+void
+timingWheelTimerQueue::cascade(const std::size_t level) noexcept
+{
+  listIndex list {overflowList};
+
+  if ( level < numLevels )
+  {
+    auto index = static_cast<std::size_t>((currentTick_ >> (levelBits * level)) & (numBuckets - 1));
+    list = static_cast<listIndex>(level * numBuckets + index);
+    setBucketBit(level, index, false);
+  }
+
+  auto slot = heads_[list];
+  heads_[list] = noSlot;
+  while ( noSlot != slot )
+  {
+    auto next = nodes_[slot].next;
+    place(slot);
+    slot = next;
+  }
+}
+
+std::size_t
+timingWheelTimerQueue::nextBucket(const std::size_t level, const std::size_t index) const noexcept
+{
+  // the buckets strictly after index
+  auto first = index + 1;
+
+  if ( first >= numBuckets )
+  {
+    return numBuckets;
+  }
+
+  auto word = first / 64;
+  auto bits = bitmaps_[level][word] & (~std::uint64_t {0} << (first % 64));
+  for (;;)
+  {
+    if ( 0 != bits )
+    {
+      return word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+    }
+    if ( ++word == numBitmapWords )
+    {
+      return numBuckets;
+    }
+    bits = bitmaps_[level][word];
+  }
+}
+
+void
+timingWheelTimerQueue::setBucketBit(const std::size_t level, const std::size_t index, const bool isSet) noexcept
+{
+  auto mask = std::uint64_t {1} << (index % 64);
+
+  if ( isSet )
+  {
+    bitmaps_[level][index / 64] |= mask;
+  }
+  else
+  {
+    bitmaps_[level][index / 64] &= ~mask;
+  }
+}
+}  // namespace DTS
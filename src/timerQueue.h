@@ -0,0 +1,251 @@
+/*
+ * File:   timerQueue.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 2:10 PM
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <set>
+#include <utility>
+#include <limits>
+#include <chrono>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+using timerClock = std::chrono::steady_clock;
+using timerDeadline = timerClock::time_point;
+
+// The pending timers of a timerService, identified by the slots where the
+// timer service keeps their jobs.
+// The timer service serializes all the calls.
+class timerQueue
+{
+ public:
+  using slotIndex = std::uint32_t;
+
+  timerQueue() = default;
+  timerQueue(const timerQueue& rhs) = delete;
+  timerQueue& operator=(const timerQueue& rhs) = delete;
+  timerQueue(timerQueue&& rhs) = delete;
+  timerQueue& operator=(timerQueue&& rhs) = delete;
+
+  virtual ~timerQueue() noexcept;
+
+  virtual
+  void
+  push(const slotIndex slot, const timerDeadline deadline) noexcept(false) = 0;
+
+  // slot must be pending and deadline be the one it was pushed with
+  virtual
+  void
+  erase(const slotIndex slot, const timerDeadline deadline) noexcept = 0;
+
+  // when the timer thread must wake up next; it may be earlier than the
+  // earliest deadline, never later than it rounded up to the resolution of
+  // the queue; undefined if the queue is empty
+  virtual
+  timerDeadline
+  nextDeadline() const noexcept = 0;
+
+  // remove the slots whose deadline is not after now and append them to expired
+  virtual
+  void
+  popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false) = 0;
+
+  virtual
+  std::size_t
+  size() const noexcept = 0;
+
+  bool
+  empty() const noexcept
+  {
+    return 0 == size();
+  }
+};  // class timerQueue
+
+// The timers ordered by deadline in a balanced tree: O(log n) push and erase,
+// exact deadlines
+class orderedTimerQueue final : public timerQueue
+{
+ public:
+  orderedTimerQueue() = default;
+
+  void
+  push(const slotIndex slot, const timerDeadline deadline) noexcept(false) override;
+
+  void
+  erase(const slotIndex slot, const timerDeadline deadline) noexcept override;
+
+  timerDeadline
+  nextDeadline() const noexcept override;
+
+  void
+  popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false) override;
+
+  std::size_t
+  size() const noexcept override;
+
+ private:
+  std::set<std::pair<timerDeadline, slotIndex>> queue_ {};
+};  // class orderedTimerQueue
+
+// A 4-ary min-heap of compact (deadline, slot) pairs in contiguous memory, the
+// jobs staying out of line in the timer service: sifting touches few cache
+// lines, and the heap index of every slot is tracked so that erase is
+// O(log n) like push, with exact deadlines
+class dAryHeapTimerQueue final : public timerQueue
+{
+ public:
+  static constexpr std::size_t arity {4};
+
+  dAryHeapTimerQueue() = default;
+
+  void
+  push(const slotIndex slot, const timerDeadline deadline) noexcept(false) override;
+
+  void
+  erase(const slotIndex slot, const timerDeadline deadline) noexcept override;
+
+  timerDeadline
+  nextDeadline() const noexcept override;
+
+  void
+  popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false) override;
+
+  std::size_t
+  size() const noexcept override;
+
+ private:
+  using heapIndex = std::uint32_t;
+
+  struct heapEntry
+  {
+    timerDeadline deadline {};
+    slotIndex slot {};
+  };
+
+  std::vector<heapEntry> heap_ {};
+  // where each pending slot is in heap_
+  std::vector<heapIndex> heapIndex_ {};
+
+  void
+  removeAt(const heapIndex i) noexcept;
+
+  void
+  siftUp(heapIndex i) noexcept;
+
+  void
+  siftDown(heapIndex i) noexcept;
+};  // class dAryHeapTimerQueue
+
+// A hierarchical hashed timing wheel: 4 levels of 256 buckets each, level L
+// counting units of 256^L ticks, plus an overflow list beyond 2^32 ticks.
+// A timer is linked in the bucket of the level matching how far its deadline
+// is, and moved down a level when the wheel reaches the bucket: push and erase
+// are O(1) whatever the number of pending timers.
+// Deadlines are rounded up to the tick resolution, so timers never fire early
+// and fire at most one tick late.
+class timingWheelTimerQueue final : public timerQueue
+{
+ public:
+  using tickDuration = std::chrono::nanoseconds;
+
+  static constexpr std::size_t numLevels {4};
+  static constexpr std::size_t levelBits {8};
+  static constexpr std::size_t numBuckets {1u << levelBits};
+
+  explicit
+  timingWheelTimerQueue(const tickDuration tick = std::chrono::milliseconds(1),
+                        const timerDeadline origin = timerClock::now()) noexcept;
+
+  tickDuration
+  tick() const noexcept
+  {
+    return tick_;
+  }
+
+  void
+  push(const slotIndex slot, const timerDeadline deadline) noexcept(false) override;
+
+  void
+  erase(const slotIndex slot, const timerDeadline deadline) noexcept override;
+
+  timerDeadline
+  nextDeadline() const noexcept override;
+
+  void
+  popExpired(const timerDeadline now, std::vector<slotIndex>& expired) noexcept(false) override;
+
+  std::size_t
+  size() const noexcept override;
+
+ private:
+  using tickCount = std::uint64_t;
+  using listIndex = std::uint32_t;
+
+  static constexpr slotIndex noSlot {std::numeric_limits<slotIndex>::max()};
+  // the lists after the buckets: timers already due, and timers too far
+  static constexpr listIndex dueList {numLevels * numBuckets};
+  static constexpr listIndex overflowList {dueList + 1};
+  static constexpr std::size_t numBitmapWords {numBuckets / 64};
+
+  struct timerNode
+  {
+    slotIndex prev {noSlot};
+    slotIndex next {noSlot};
+    listIndex list {};
+    tickCount expiry {};
+  };
+
+  const tickDuration tick_;
+  const timerDeadline origin_;
+  // all the ticks up to this one have been processed
+  tickCount currentTick_ {0};
+  std::size_t size_ {0};
+
+  // the intrusive lists are linked through the nodes, indexed by slot
+  std::vector<timerNode> nodes_ {};
+  std::array<slotIndex, overflowList + 1> heads_ {};
+  // the non-empty buckets of each level
+  std::array<std::array<std::uint64_t, numBitmapWords>, numLevels> bitmaps_ {};
+
+  tickCount
+  toTicks(const timerDeadline deadline) const noexcept;
+
+  void
+  place(const slotIndex slot) noexcept;
+
+  void
+  link(const slotIndex slot, const listIndex list) noexcept;
+
+  void
+  unlink(const slotIndex slot) noexcept;
+
+  void
+  cascade(const std::size_t level) noexcept;
+
+  // the first tick after currentTick_ where a bucket of any level, or the
+  // overflow list, is reached, or the max tickCount if there is none
+  tickCount
+  nextEventTick() const noexcept;
+
+  // the first non-empty bucket of level after index, or numBuckets
+  std::size_t
+  nextBucket(const std::size_t level, const std::size_t index) const noexcept;
+
+  void
+  setBucketBit(const std::size_t level, const std::size_t index, const bool isSet) noexcept;
+};  // class timingWheelTimerQueue
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
@@ -0,0 +1,517 @@
+/*
+ * File:   timerService.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 9:05 AM
+ */
+#include "timerService.h"
+#include <algorithm>
+#include <iostream>
+#if defined(DTS_USE_TIMERFD) && defined(__linux__)
+#define DTS_TIMERFD_BACKEND
+#include <cerrno>
+#include <limits>
+#include <system_error>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+#ifdef DTS_TIMERFD_BACKEND
+namespace
+{
+int
+checkedFd(const int fd, const char* what) noexcept(false)
+{
+  if ( fd < 0 )
+  {
+    throw std::system_error(errno, std::generic_category(), what);
+  }
+  return fd;
+}
+
+int
+makeEpoll(const int timerFd, const int eventFd) noexcept(false)
+{
+  auto epollFd = checkedFd(::epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+
+  for (auto fd : {timerFd, eventFd})
+  {
+    epoll_event ev {};
+
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if ( ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 )
+    {
+      auto error = errno;
+      ::close(epollFd);
+      throw std::system_error(error, std::generic_category(), "epoll_ctl");
+    }
+  }
+  return epollFd;
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux
+itimerspec
+toItimerspec(const timerDeadline deadline) noexcept
+{
+  auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+  itimerspec its {};
+
+  // a zero it_value would disarm the timer
+  sinceEpoch = std::max(sinceEpoch, std::chrono::nanoseconds {1});
+  its.it_value.tv_sec = static_cast<time_t>(sinceEpoch.count() / 1'000'000'000);
+  its.it_value.tv_nsec = static_cast<long>(sinceEpoch.count() % 1'000'000'000);
+  return its;
+}
+
+// the timeout of epoll_wait() up to deadline, rounded up so that the timers
+// are not collected before it
+int
+toEpollTimeout(const timerDeadline deadline) noexcept
+{
+  auto timeout = std::chrono::ceil<std::chrono::milliseconds>(deadline - timerClock::now()).count();
+
+  return static_cast<int>(std::clamp<decltype(timeout)>(timeout, 0, std::numeric_limits<int>::max()));
+}
+}  // namespace
+#endif
+
+timerTask::~timerTask() noexcept = default;
+
+timerService::timerService(executor& ex) noexcept(false)
+:
+timerService(std::make_unique<orderedTimerQueue>(), ex)
+{}
+
+timerService::timerService(std::unique_ptr<timerQueue>&& queue, executor& ex) noexcept(false)
+:
+executor_ (ex),
+queue_ (std::move(queue)),
+#ifdef DTS_TIMERFD_BACKEND
+timerFd_ (checkedFd(::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK), "timerfd_create")),
+eventFd_ (checkedFd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "eventfd")),
+epollFd_ (makeEpoll(timerFd_, eventFd_)),
+#endif
+timerThread_ ([this] () { timerThreadLoop(); })
+{}
+
+timerService::~timerService() noexcept
+{
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    stop_ = true;
+  }
+  wakeUp();
+  timerThread_.join();
+  // the owners of the tasks still armed may be waiting for them
+  for (auto& entry : entries_)
+  {
+    if ( entry.armed && (nullptr != entry.task) )
+    {
+      entry.task->dropped();
+    }
+  }
+#ifdef DTS_TIMERFD_BACKEND
+  ::close(epollFd_);
+  ::close(eventFd_);
+  ::close(timerFd_);
+#endif
+}
+
+timerService&
+timerService::defaultTimerService() noexcept
+{
+  static timerService ts {};
+  return ts;
+}
+
+timerService::timerId
+timerService::schedule(const timerDeadline deadline,
+                       timerJob&& job,
+                       executor* ex) noexcept(false)
+{
+  bool isEarliest {};
+  timerId id {invalidTimerId};
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    isEarliest = queue_->empty() || (deadline < queue_->nextDeadline());
+    id = arm(deadline, std::move(job), nullptr, ex);
+  }
+  // the timer thread must wait again only if its next deadline changed
+  if ( isEarliest )
+  {
+    wakeUp();
+  }
+  return id;
+}
+
+timerService::timerId
+timerService::schedule(const timerDeadline deadline,
+                       timerTask& task,
+                       executor* ex) noexcept(false)
+{
+  bool isEarliest {};
+  timerId id {invalidTimerId};
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    isEarliest = queue_->empty() || (deadline < queue_->nextDeadline());
+    id = arm(deadline, timerJob {}, &task, ex);
+  }
+  if ( isEarliest )
+  {
+    wakeUp();
+  }
+  return id;
+}
+
+std::vector<timerService::timerId>
+timerService::schedule(std::vector<timerRequest>&& requests) noexcept(false)
+{
+  bool isEarliest {};
+  std::vector<timerId> ids {};
+
+  ids.reserve(requests.size());
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    auto wasEmpty = queue_->empty();
+    auto nextDeadline = wasEmpty ? timerDeadline::max() : queue_->nextDeadline();
+
+    for (auto& request : requests)
+    {
+      isEarliest = isEarliest || wasEmpty || (request.deadline < nextDeadline);
+      ids.push_back(arm(request.deadline, std::move(request.job), request.task, request.ex));
+    }
+  }
+  if ( isEarliest )
+  {
+    wakeUp();
+  }
+  return ids;
+}
+
+bool
+timerService::cancel(const timerId id) noexcept
+{
+  // the job is destroyed, or the task told, outside the lock
+  releasedTimer timer {};
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    auto slot = static_cast<slotIndex>(id & 0xffff'ffffu);
+    auto generation = static_cast<std::uint32_t>(id >> 32);
+
+    if ( (slot >= entries_.size()) ||
+         (false == entries_[slot].armed) ||
+         (generation != entries_[slot].generation) )
+    {
+      return false;
+    }
+    queue_->erase(slot, entries_[slot].deadline);
+    timer = releaseSlot(slot);
+  }
+  if ( nullptr != timer.task )
+  {
+    timer.task->dropped();
+  }
+  return true;
+}
+
+std::size_t
+timerService::pendingTimers() const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  return queue_->size();
+}
+
+bool
+timerService::pinTimerThread(const cpuSet& cpus) noexcept
+{
+  return pinThread(timerThread_, cpus);
+}
+
+executor&
+timerService::getExecutor() const noexcept
+{
+  return executor_;
+}
+
+void
+timerService::setSlack(const std::chrono::nanoseconds slack) noexcept
+{
+  {
+    std::lock_guard<std::mutex> lg(mx_);
+    slack_ = std::max(slack, std::chrono::nanoseconds::zero());
+  }
+  wakeUp();
+}
+
+std::chrono::nanoseconds
+timerService::getSlack() const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  return slack_;
+}
+
+std::uint64_t
+timerService::firingRounds() const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  return firingRounds_;
+}
+
+timerService::latenessStats
+timerService::firingLateness() const noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+  latenessStats stats {};
+
+  stats.firedTimers = firedTimers_;
+  if ( firedTimers_ > 0 )
+  {
+    stats.mean = totalLateness_ / firedTimers_;
+  }
+  stats.max = maxLateness_;
+  return stats;
+}
+
+void
+timerService::resetFiringLateness() noexcept
+{
+  std::lock_guard<std::mutex> lg(mx_);
+
+  firedTimers_ = 0;
+  totalLateness_ = std::chrono::nanoseconds::zero();
+  maxLateness_ = std::chrono::nanoseconds::zero();
+}
+
+const char*
+timerService::backendName() noexcept
+{
+#ifdef DTS_TIMERFD_BACKEND
+  return "timerfd";
+#else
+  return "condition_variable";
+#endif
+}
+
+timerService::slotIndex
+timerService::acquireSlot() noexcept(false)
+{
+  if ( freeSlots_.empty() )
+  {
+    entries_.emplace_back();
+    return static_cast<slotIndex>(entries_.size() - 1);
+  }
+  auto slot = freeSlots_.back();
+  freeSlots_.pop_back();
+  return slot;
+}
+
+timerService::timerId
+timerService::arm(const timerDeadline deadline,
+                  timerJob&& job,
+                  timerTask* task,
+                  executor* ex) noexcept(false)
+{
+  auto slot = acquireSlot();
+
+  try
+  {
+    queue_->push(slot, deadline);
+  }
+  catch (...)
+  {
+    freeSlots_.push_back(slot);
+    throw;
+  }
+
+  auto& entry = entries_[slot];
+
+  entry.deadline = deadline;
+  entry.job = std::move(job);
+  entry.task = task;
+  entry.ex = ex;
+  entry.armed = true;
+  return makeTimerId(slot, entry.generation);
+}
+
+timerService::releasedTimer
+timerService::releaseSlot(const slotIndex slot) noexcept
+{
+  auto& entry = entries_[slot];
+  releasedTimer timer {std::move(entry.job), entry.task, entry.ex};
+
+  entry.job = nullptr;
+  entry.task = nullptr;
+  entry.ex = nullptr;
+  entry.armed = false;
+  ++entry.generation;
+  freeSlots_.push_back(slot);
+  return timer;
+}
+
+void
+timerService::timerThreadLoop() noexcept
+{
+  std::vector<releasedTimer> expired {};
+  std::vector<slotIndex> expiredSlots {};
+  std::unique_lock<std::mutex> lk(mx_);
+
+  while ( false == stop_ )
+  {
+    if ( queue_->empty() )
+    {
+      waitForTimers(lk, nullptr);
+      continue;
+    }
+    // with a slack the earliest timer can wait for the ones due shortly after
+    if ( auto deadline = queue_->nextDeadline() + slack_;
+         timerClock::now() < deadline )
+    {
+      waitForTimers(lk, &deadline);
+      continue;
+    }
+    ++firingRounds_;
+    // collect all the timers expired so far and post them to their
+    // executors without holding the lock
+    auto now = timerClock::now();
+    auto popFailed {false};
+    try
+    {
+      queue_->popExpired(now, expiredSlots);
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "[" << __func__ << "] "
+                << "expired timers not collected: "
+                << e.what()
+                << std::endl;
+      popFailed = true;
+    }
+    for (auto slot : expiredSlots)
+    {
+      auto lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(now - entries_[slot].deadline,
+                                                                                    timerClock::duration::zero()));
+
+      ++firedTimers_;
+      totalLateness_ += lateness;
+      maxLateness_ = std::max(maxLateness_, lateness);
+      expired.emplace_back(releaseSlot(slot));
+    }
+    expiredSlots.clear();
+    lk.unlock();
+    for (auto& timer : expired)
+    {
+      dispatch(std::move(timer));
+    }
+    expired.clear();
+    lk.lock();
+    if ( popFailed && (false == stop_) )
+    {
+      // the timers left in the queue are still expired: retrying at once
+      // would spin, so wait a while for memory to be released, or for a
+      // wake-up
+      auto retry = timerClock::now() + std::chrono::milliseconds(10);
+      waitForTimers(lk, &retry);
+    }
+  }
+}
+
+void
+timerService::waitForTimers(std::unique_lock<std::mutex>& lk, const timerDeadline* deadline) noexcept
+{
+#ifdef DTS_TIMERFD_BACKEND
+  // an absolute deadline of the monotonic clock, or disarmed
+  auto its = (nullptr == deadline) ? itimerspec {} : toItimerspec(*deadline);
+  std::uint64_t count {};
+  epoll_event events[2] {};
+
+  auto timeout {-1};
+
+  if ( ::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &its, nullptr) < 0 )
+  {
+    std::cerr << "[" << __func__ << "] "
+              << "timerfd not armed: "
+              << std::system_error(errno, std::generic_category()).what()
+              << std::endl;
+    // the timer would never expire: bound the wait by the deadline instead
+    if ( nullptr != deadline )
+    {
+      timeout = toEpollTimeout(*deadline);
+    }
+  }
+  lk.unlock();
+  // a wakeUp() after the unlock leaves the eventfd readable, so it is not lost
+  if ( ::epoll_wait(epollFd_, events, 2, timeout) > 0 )
+  {
+    while ( ::read(eventFd_, &count, sizeof(count)) > 0 ) {}
+    while ( ::read(timerFd_, &count, sizeof(count)) > 0 ) {}
+  }
+  lk.lock();
+#else
+  if ( nullptr == deadline )
+  {
+    cv_.wait(lk);
+  }
+  else
+  {
+    cv_.wait_until(lk, *deadline);
+  }
+#endif
+}
+
+void
+timerService::wakeUp() noexcept
+{
+#ifdef DTS_TIMERFD_BACKEND
+  std::uint64_t one {1};
+
+  if ( ::write(eventFd_, &one, sizeof(one)) < 0 )
+  {
+    // EAGAIN: the counter is saturated, the timer thread is awake anyway
+  }
+#else
+  cv_.notify_one();
+#endif
+}
+
+void
+timerService::dispatch(releasedTimer&& timer) noexcept
+{
+  auto& ex {(nullptr == timer.ex) ? executor_ : *timer.ex};
+
+  try
+  {
+    if ( nullptr == timer.task )
+    {
+      ex.post(std::move(timer.job));
+    }
+    else
+    {
+      // a lambda capturing a pointer is stored inline by std::function
+      ex.post([task = timer.task] () { task->fire(); });
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "[" << __func__ << "] "
+              << "timer job not dispatched: "
+              << e.what()
+              << std::endl;
+    if ( nullptr != timer.task )
+    {
+      timer.task->dropped();
+    }
+  }
+}
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
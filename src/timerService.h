@@ -0,0 +1,262 @@
+/*
+ * File:   timerService.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 9:05 AM
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include "executor.h"
+#include "timerQueue.h"
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+using timerJob = executorTask;
+
+// a timer job kept by its owner and armed again and again, e.g. by every
+// re-arm of a timeout: the timer service keeps a pointer to it, so that
+// arming it allocates nothing
+class timerTask
+{
+ public:
+  timerTask() = default;
+  timerTask(const timerTask& rhs) = delete;
+  timerTask& operator=(const timerTask& rhs) = delete;
+  timerTask(timerTask&& rhs) = delete;
+  timerTask& operator=(timerTask&& rhs) = delete;
+
+  virtual ~timerTask() noexcept;
+
+  // run on the executor when the timer expires
+  virtual
+  void
+  fire() noexcept = 0;
+
+  // called instead of fire() when the timer is removed before expiring, by
+  // cancel() or by the destruction of the timer service, or when fire()
+  // cannot be posted to the executor
+  virtual
+  void
+  dropped() noexcept = 0;
+};  // class timerTask
+
+// One timer thread serving the deadlines of many deferred tasks.
+// A pending timer costs an entry in a timer queue, not a sleeping thread; when
+// a timer expires its job is posted to an executor.
+class timerService final
+{
+ public:
+  // (generation << 32) | slot; 0 is never returned by schedule()
+  using timerId = std::uint64_t;
+  static constexpr timerId invalidTimerId {0};
+
+  // a timer of a batch: job is posted to ex, or to the executor of the timer
+  // service if ex is nullptr, as soon as deadline is reached; if task is set,
+  // it is armed instead of job
+  struct timerRequest
+  {
+    timerDeadline deadline {};
+    timerJob job {};
+    executor* ex {nullptr};
+    timerTask* task {nullptr};
+  };
+
+  timerService(const timerService& rhs) = delete;
+  timerService& operator=(const timerService& rhs) = delete;
+  timerService(timerService&& rhs) = delete;
+  timerService& operator=(timerService&& rhs) = delete;
+
+  // jobs scheduled without an executor of their own are posted to ex; the
+  // timers are kept in an orderedTimerQueue
+  explicit
+  timerService(executor& ex = threadPerTaskExecutor::defaultExecutor()) noexcept(false);
+
+  // the timers are kept in queue, e.g. a timingWheelTimerQueue when millions
+  // of timers are pending
+  explicit
+  timerService(std::unique_ptr<timerQueue>&& queue,
+               executor& ex = threadPerTaskExecutor::defaultExecutor()) noexcept(false);
+
+  // pending timers are dropped: their jobs are destroyed without being run
+  ~timerService() noexcept;
+
+  // the timer service shared by all instances that do not provide their own
+  static
+  timerService&
+  defaultTimerService() noexcept;
+
+  // post job to ex, or to the executor of the timer service if ex is
+  // nullptr, as soon as deadline is reached
+  timerId
+  schedule(const timerDeadline deadline,
+           timerJob&& job,
+           executor* ex = nullptr) noexcept(false);
+
+  // as above for a timer task, which must outlive its timer: the fire() of
+  // task is posted when deadline is reached, else its dropped() is called
+  timerId
+  schedule(const timerDeadline deadline,
+           timerTask& task,
+           executor* ex = nullptr) noexcept(false);
+
+  // schedule all the timers of the batch under a single lock acquisition,
+  // waking up the timer thread at most once; the ids are returned in the
+  // order of the requests
+  std::vector<timerId>
+  schedule(std::vector<timerRequest>&& requests) noexcept(false);
+
+  // remove a pending timer; return false if it already expired or is unknown
+  bool
+  cancel(const timerId id) noexcept;
+
+  std::size_t
+  pendingTimers() const noexcept;
+
+  // where the jobs scheduled without an executor of their own are posted
+  executor&
+  getExecutor() const noexcept;
+
+  // pin the timer thread to cpus; false if they are not valid or on systems
+  // other than Linux
+  bool
+  pinTimerThread(const cpuSet& cpus) noexcept;
+
+  // let the timers fire up to slack after their deadline, never before: the
+  // timer thread waits until the earliest deadline plus slack, then fires
+  // together all the timers due by then, so that deadlines close to each
+  // other cost a single wakeup
+  void
+  setSlack(const std::chrono::nanoseconds slack) noexcept;
+
+  std::chrono::nanoseconds
+  getSlack() const noexcept;
+
+  // how many times the timer thread woke up to fire expired timers
+  std::uint64_t
+  firingRounds() const noexcept;
+
+  // how late the timers fired: from their deadline to their collection by
+  // the timer thread, before being posted to the executor
+  struct latenessStats
+  {
+    std::uint64_t firedTimers {0};
+    std::chrono::nanoseconds mean {0};
+    std::chrono::nanoseconds max {0};
+  };
+
+  latenessStats
+  firingLateness() const noexcept;
+
+  void
+  resetFiringLateness() noexcept;
+
+  // how the timer thread waits: "timerfd" when built with DTS_USE_TIMERFD
+  // on Linux, "condition_variable" otherwise
+  static
+  const char*
+  backendName() noexcept;
+
+ private:
+  using slotIndex = timerQueue::slotIndex;
+
+  struct timerEntry
+  {
+    timerDeadline deadline {};
+    timerJob job {};
+    timerTask* task {nullptr};
+    executor* ex {nullptr};
+    std::uint32_t generation {1};
+    bool armed {false};
+  };
+
+  // what a timer leaves when it expires or is removed
+  struct releasedTimer
+  {
+    timerJob job {};
+    timerTask* task {nullptr};
+    executor* ex {nullptr};
+  };
+
+  executor& executor_;
+
+  mutable std::mutex mx_ {};
+  std::condition_variable cv_ {};
+
+  // timer entries are recycled through the free list so that their ids stay
+  // small and stable; the generation tells apart reuses of the same slot
+  std::vector<timerEntry> entries_ {};
+  std::vector<slotIndex> freeSlots_ {};
+  // the armed slots
+  std::unique_ptr<timerQueue> queue_ {};
+
+  std::chrono::nanoseconds slack_ {0};
+  std::uint64_t firingRounds_ {0};
+  std::uint64_t firedTimers_ {0};
+  std::chrono::nanoseconds totalLateness_ {0};
+  std::chrono::nanoseconds maxLateness_ {0};
+
+  // the timer thread waits on cv_, or, with the timerfd backend, in epoll on
+  // a timerfd armed at the next deadline and on an eventfd written to wake it
+  // up; -1 when not used
+  int timerFd_ {-1};
+  int eventFd_ {-1};
+  int epollFd_ {-1};
+
+  bool stop_ {false};
+  std::thread timerThread_ {};
+
+  static
+  timerId
+  makeTimerId(const slotIndex slot, const std::uint32_t generation) noexcept
+  {
+    return (static_cast<timerId>(generation) << 32) | slot;
+  }
+
+  slotIndex
+  acquireSlot() noexcept(false);
+
+  // mx_ must be held
+  timerId
+  arm(const timerDeadline deadline,
+      timerJob&& job,
+      timerTask* task,
+      executor* ex) noexcept(false);
+
+  releasedTimer
+  releaseSlot(const slotIndex slot) noexcept;
+
+  void
+  timerThreadLoop() noexcept;
+
+  // wait for a change of the timers or until deadline, if any; lk is
+  // released while waiting
+  void
+  waitForTimers(std::unique_lock<std::mutex>& lk, const timerDeadline* deadline) noexcept;
+
+  // make the timer thread look at the timers again
+  void
+  wakeUp() noexcept;
+
+  // post the job, or the fire() of the task, of an expired timer
+  void
+  dispatch(releasedTimer&& timer) noexcept;
+};  // class timerService
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
@@ -0,0 +1,326 @@
+/* 
+ * File:   allocationTests.cpp
+ * Author: massimo
+ *
+ * Created on October 17, 2026
+ */
+
+#include "../deferredThreadScheduler.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <array>
+#include <cstdlib>
+#include <new>
+////////////////////////////////////////////////////////////////////////////////
+// the tests that count the allocations of the code under test: they replace
+// the global operator new and operator delete, hence their own executable
+////////////////////////////////////////////////////////////////////////////////
+using namespace ::testing;
+using namespace ::DTS;
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+#pragma clang diagnostic ignored "-Wzero-as-null-pointer-constant"
+////////////////////////////////////////////////////////////////////////////////
+// the allocations made by each thread, counted by every form of the global
+// operator new, which fails once a thread has made allocationLimit of them
+thread_local std::size_t allocationsOnThisThread {0};
+thread_local std::size_t allocationLimit {SIZE_MAX};
+
+namespace
+{
+void*
+countedAllocation(std::size_t size, const std::size_t alignment) noexcept
+{
+  if ( allocationsOnThisThread >= allocationLimit )
+  {
+    return nullptr;
+  }
+  ++allocationsOnThisThread;
+  size = (0 == size) ? 1 : size;
+  if ( alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ )
+  {
+    return std::malloc(size);
+  }
+  // std::aligned_alloc() takes a multiple of the alignment
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void*
+countedAllocationOrThrow(const std::size_t size, const std::size_t alignment) noexcept(false)
+{
+  if ( void* p = countedAllocation(size, alignment) )
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+}  // namespace
+
+void*
+operator new(std::size_t size)
+{
+  return countedAllocationOrThrow(size, 0);
+}
+
+void*
+operator new[](std::size_t size)
+{
+  return countedAllocationOrThrow(size, 0);
+}
+
+void*
+operator new(std::size_t size, std::align_val_t al)
+{
+  return countedAllocationOrThrow(size, static_cast<std::size_t>(al));
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t al)
+{
+  return countedAllocationOrThrow(size, static_cast<std::size_t>(al));
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return countedAllocation(size, 0);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return countedAllocation(size, 0);
+}
+
+void*
+operator new(std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  return countedAllocation(size, static_cast<std::size_t>(al));
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  return countedAllocation(size, static_cast<std::size_t>(al));
+}
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+////////////////////////////////////////////////////////////////////////////////
+// re-arming the timeout of an instance using a timer service allocates
+// nothing, and the instance still runs once re-armed for good
+TEST(allocations, test_1)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  threadFun seven = [] () { return 7; };
+  timerService ts {std::make_unique<dAryHeapTimerQueue>()};
+  dtsType dts {"rearmed"};
+
+  dts.useTimerService(ts).registerThread(seven).runIn(3600s);
+  // the first re-arm reserves the storage of the timer queue
+  dts.rearm(3600s);
+
+  auto allocations {allocationsOnThisThread};
+  for (auto i {0}; i < 1000; ++i)
+  {
+    dts.rearm(3600s);
+  }
+  ASSERT_EQ(allocations, allocationsOnThisThread);
+  ASSERT_EQ(1u, ts.pendingTimers());
+
+  dts.rearm(1ms);
+  auto [state, result] = dts.wait();
+  ASSERT_EQ(static_cast<int>(deferredThreadSchedulerBase::threadState::Run), state);
+  ASSERT_EQ(7, result);
+}
+
+// the periods of an instance using a timer service allocate nothing on the
+// worker that runs them
+TEST(allocations, test_2)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  workerPool pool {1};
+  timerService ts {std::make_unique<dAryHeapTimerQueue>(), pool};
+  std::atomic<int> runs {0};
+  std::array<std::size_t, 2> allocations {};
+  threadFun tick = [&runs, &allocations] ()
+                   {
+                     auto r {++runs};
+
+                     // the first periods reserve the storage of the timer queue
+                     if ( 10 == r )
+                     {
+                       allocations[0] = allocationsOnThisThread;
+                     }
+                     else if ( 110 == r )
+                     {
+                       allocations[1] = allocationsOnThisThread;
+                     }
+                     return r;
+                   };
+  deferredThreadScheduler<threadResultType, threadFun> dts {"tick"};
+
+  dts.useTimerService(ts).registerThread(tick).runEvery(100us);
+  while ( runs < 110 )
+  {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(true, dts.cancelThread());
+  auto [threadState, threadResult] = dts.wait();
+  ASSERT_EQ(dts.isCanceled(threadState), true);
+  ASSERT_EQ(allocations[0], allocations[1]);
+}
+
+// a worker pool that cannot start all its workers stops and joins the ones
+// already started before the exception propagates
+TEST(allocations, test_3)
+{
+  auto failures {0};
+  auto built {false};
+
+  // the n-th allocation of the constructor fails, for n growing until none
+  // fails
+  for (std::size_t n {}; false == built; ++n)
+  {
+    allocationLimit = allocationsOnThisThread + n;
+    try
+    {
+      workerPool wp {4};
+      workStealingPool wsp {4};
+
+      allocationLimit = SIZE_MAX;
+      built = true;
+    }
+    catch (const std::bad_alloc&)
+    {
+      allocationLimit = SIZE_MAX;
+      ++failures;
+    }
+  }
+  ASSERT_EQ(true, failures > 4);
+}
+
+// a completion is pushed through the node embedded in the instance, with no
+// allocation, unless its previous one is still queued; empty completion
+// callables are refused
+TEST(allocations, test_4)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  using threadState = deferredThreadSchedulerBase::threadState;
+  threadFun seven = [] () { return 7; };
+  timerService ts {std::make_unique<dAryHeapTimerQueue>()};
+  completionQueue q {};
+  std::vector<completionQueue::completion> batch {};
+  dtsType dts {"rearmed"};
+
+  batch.reserve(4);
+  dts.useTimerService(ts).useCompletionQueue(q).registerThread(seven).runIn(3600s);
+  dts.rearm(3600s);
+  ASSERT_EQ(1u, q.drain(batch));
+  batch.clear();
+
+  // each re-arm cancels the pending run, whose completion is drained
+  auto allocations {allocationsOnThisThread};
+  for (auto i {0}; i < 1000; ++i)
+  {
+    dts.rearm(3600s);
+    ASSERT_EQ(1u, q.drain(batch));
+    batch.clear();
+  }
+  ASSERT_EQ(allocations, allocationsOnThisThread);
+
+  // not drained in between: the second completion takes a node of its own
+  dts.rearm(3600s);
+  dts.rearm(3600s);
+  ASSERT_EQ(allocations + 1, allocationsOnThisThread);
+  ASSERT_EQ(2u, q.drain(batch));
+  ASSERT_EQ(&dts, batch[0].dts);
+  ASSERT_EQ(&dts, batch[1].dts);
+  ASSERT_EQ(static_cast<int>(threadState::Canceled), batch[1].state);
+  ASSERT_EQ(true, dts.cancelThread());
+  ASSERT_EQ(1u, q.drain(batch));
+
+  dtsType empty {"empty"};
+  ASSERT_THROW(empty.onCompletion(std::function<void(baseThreadStateType, const threadResultType*)> {}),
+               std::invalid_argument);
+  ASSERT_EQ(false, dts.postOnCompletion(executorTask {}));
+}
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here
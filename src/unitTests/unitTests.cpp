@@ -6,9 +6,20 @@
  */
 
 #include "../deferredThreadScheduler.h"
+#include "../deferredThreadSchedulerPool.h"
+#include "../coroutines.h"
+#include "../taskGraph.h"
 #include "concurrentLogging.h"
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <set>
+#include <random>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 ////////////////////////////////////////////////////////////////////////////////
 using namespace ::testing;
 using namespace ::utilities;
@@ -826,6 +837,2022 @@ TEST(deferredThreadScheduler, test_14)
   }
 }
 
+// schedule many threads served by the shared timer thread, and run them
+TEST(deferredThreadScheduler, test_15)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsSharedPtr = std::shared_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  std::vector<dtsSharedPtr> v {};
+  auto deferredTime {2s};
+  const int numThreads {10'000};
+
+  for (int i {1}; i <= numThreads; ++i)
+  {
+    auto dtsPtr = makeSharedDeferredThreadScheduler<threadResultType, threadFun>("intFoo");
+    dtsPtr.get()->useTimerService().registerThread([i]() noexcept(false) -> threadResultType
+                                                   {
+                                                     return i;
+                                                   });
+    v.push_back(dtsPtr);
+  }
+  for (auto& dts : v)
+  {
+    dts.get()->runIn(deferredTime);
+
+    ASSERT_EQ(dts.get()->isScheduled(), true);
+  }
+  // the timers are queue entries, not sleeping threads
+  ASSERT_EQ(numThreads, timerService::defaultTimerService().pendingTimers());
+
+  int i {1};
+  for (auto& dts : v)
+  {
+    auto [threadState, threadResult] = dts.get()->wait();
+    ASSERT_EQ(i++, threadResult);
+    ASSERT_EQ(dts.get()->isRun(threadState), true);
+  }
+  ASSERT_EQ(0, timerService::defaultTimerService().pendingTimers());
+}
+
+// cancel threads served by the shared timer thread
+TEST(deferredThreadScheduler, test_16)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsSharedPtr = std::shared_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  std::vector<dtsSharedPtr> v {};
+  timerService ts {};
+  const int numThreads {1'000};
+
+  for (int i {1}; i <= numThreads; ++i)
+  {
+    auto dtsPtr = makeSharedDeferredThreadScheduler<threadResultType, threadFun>("intFoo");
+    dtsPtr.get()->useTimerService(ts).registerThread([]() noexcept(false) -> threadResultType
+                                                     {
+                                                       return 42;
+                                                     }).runIn(60s);
+    v.push_back(dtsPtr);
+  }
+  ASSERT_EQ(numThreads, ts.pendingTimers());
+  for (auto& dts : v)
+  {
+    ASSERT_EQ(true, dts.get()->cancelThread());
+    ASSERT_EQ(dts.get()->isCanceled(), true);
+  }
+  // the test should not take 60 seconds: canceled timers left the queue
+  ASSERT_EQ(0, ts.pendingTimers());
+  for (auto& dts : v)
+  {
+    auto [threadState, threadResult] = dts.get()->wait();
+    ASSERT_EQ(dts.get()->isCanceled(threadState), true);
+  }
+}
+
+// schedule many threads with a deferred time of 0 seconds, and run them on a
+// pool of a few workers
+TEST(deferredThreadScheduler, test_17)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsSharedPtr = std::shared_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  std::vector<dtsSharedPtr> v {};
+  workerPool wp {4};
+  auto deferredTime {0s};
+  const int numThreads {10'000};
+
+  ASSERT_EQ(4, wp.numWorkers());
+  for (int i {1}; i <= numThreads; ++i)
+  {
+    auto dtsPtr = makeSharedDeferredThreadScheduler<threadResultType, threadFun>("intFoo", wp);
+    dtsPtr.get()->registerThread([i]() noexcept(false) -> threadResultType
+                                 {
+                                   return i;
+                                 });
+    v.push_back(dtsPtr);
+  }
+  for (auto& dts : v)
+  {
+    dts.get()->runIn(deferredTime);
+  }
+
+  std::set<std::thread::id> workerIds {};
+  int i {1};
+  for (auto& dts : v)
+  {
+    auto [threadState, threadResult] = dts.get()->wait();
+    ASSERT_EQ(i++, threadResult);
+    ASSERT_EQ(dts.get()->isRun(threadState), true);
+    workerIds.insert(dts.get()->getThreadId());
+  }
+  // all the tasks were run by the workers of the pool
+  ASSERT_LE(workerIds.size(), wp.numWorkers());
+  ASSERT_EQ(0, wp.queuedTasks());
+}
+
+// cancellation flags are looked up without being inserted, and listed as a
+// consistent snapshot
+TEST(deferredThreadScheduler, test_18)
+{
+  cancellationFlagsRegistry cfr {};
+  std::vector<std::thread::id> keys {};
+  std::vector<std::thread> threads {};
+
+  for (int i {1}; i <= 100; ++i)
+  {
+    threads.emplace_back([]() {});
+    keys.push_back(threads.back().get_id());
+  }
+  for (auto& key : keys)
+  {
+    ASSERT_EQ(false, cfr.get(key));
+  }
+  ASSERT_EQ(0, cfr.snapshot().size());
+
+  for (std::size_t i {}; i < keys.size(); i += 2)
+  {
+    ASSERT_EQ(true, cfr.set(keys[i]));
+  }
+  for (std::size_t i {}; i < keys.size(); ++i)
+  {
+    ASSERT_EQ(0 == i % 2, cfr.get(keys[i]));
+  }
+
+  auto flags {cfr.snapshot()};
+  ASSERT_EQ(keys.size() / 2, flags.size());
+  ASSERT_EQ(true, std::is_sorted(flags.begin(), flags.end()));
+  for (auto&& [uniqueKey, cancellationFlag] : flags)
+  {
+    ASSERT_EQ(true, cancellationFlag);
+  }
+
+  for (auto& key : keys)
+  {
+    cfr.erase(key);
+    ASSERT_EQ(false, cfr.get(key));
+  }
+  ASSERT_EQ(0, cfr.snapshot().size());
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+// a running task is stopped through its own stop token, which is neither seen
+// by the next task run on the same worker nor recorded in the cancellation flags
+TEST(deferredThreadScheduler, test_19)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  workerPool wp {1};
+  std::atomic<bool> running {false};
+
+  {
+    deferredThreadScheduler<threadResultType, threadFun> dts {"wellLoop", wp};
+
+    dts.registerThread([&running]() noexcept(false) -> threadResultType
+                       {
+                         running = true;
+                         while ( true )
+                         {
+                           std::this_thread::sleep_for(1ms);
+                           // safe cancellation point, use the macro
+                           TERMINATE_ON_CANCELLATION(threadResultType)
+                         }
+                       }).runIn(0s);
+    while ( false == running )
+    {
+      std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(dts.isRunning(), true);
+    ASSERT_EQ(dts.getStopToken().stopRequested(), false);
+    // dts object is destroyed and the stop of the task is requested
+  }
+  auto [cfSize, cfSet, cfUnset] = deferredThreadSchedulerBase::listCancellationFlags(std::cout);
+  ASSERT_EQ(0, cfSize);
+
+  deferredThreadScheduler<threadResultType, threadFun> dts {"intFoo", wp};
+  auto [threadState, threadResult] = dts.registerThread([]() noexcept(false) -> threadResultType
+                                                        {
+                                                          std::this_thread::sleep_for(10ms);
+                                                          TERMINATE_ON_CANCELLATION(threadResultType)
+                                                          return 111;
+                                                        }).runIn(0s).wait();
+  ASSERT_EQ(dts.isRun(threadState), true);
+  ASSERT_EQ(111, threadResult);
+}
+
+// the stop token is passed to a thread function taking it as first argument
+TEST(deferredThreadScheduler, test_20)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType(const stopToken&, int)>;
+  int arg {7};
+
+  threadFun intFoo = [](const stopToken& st, int i) noexcept(false) -> threadResultType
+                     {
+                       return (&st == stopToken::current()) ? i : 0;
+                     };
+
+  deferredThreadScheduler<threadResultType, threadFun> dts {"intFoo", intFoo, arg};
+  auto [threadState, threadResult] = dts.runIn(0s).wait();
+
+  ASSERT_EQ(dts.isRun(threadState), true);
+  ASSERT_EQ(7, threadResult);
+  ASSERT_EQ(nullptr, stopToken::current());
+}
+
+// race cancelThread() against the firing of many threads: each thread is
+// either canceled or run, never both
+TEST(deferredThreadScheduler, test_21)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsSharedPtr = std::shared_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  std::vector<dtsSharedPtr> v {};
+  workerPool wp {2};
+  std::atomic<int> runs {0};
+  const int numThreads {10'000};
+
+  for (int i {1}; i <= numThreads; ++i)
+  {
+    auto dtsPtr = makeSharedDeferredThreadScheduler<threadResultType, threadFun>("intFoo", wp);
+    dtsPtr.get()->registerThread([&runs]() noexcept(false) -> threadResultType
+                                 {
+                                   return ++runs;
+                                 });
+    v.push_back(dtsPtr);
+  }
+  for (auto& dts : v)
+  {
+    dts.get()->runIn(0s);
+  }
+  int canceled {};
+  for (auto& dts : v)
+  {
+    canceled += dts.get()->cancelThread() ? 1 : 0;
+  }
+  int run {};
+  for (auto& dts : v)
+  {
+    auto [threadState, threadResult] = dts.get()->wait();
+    ASSERT_EQ(true, dts.get()->isRun(threadState) || dts.get()->isCanceled(threadState));
+    run += dts.get()->isRun(threadState) ? 1 : 0;
+  }
+  ASSERT_EQ(numThreads, canceled + run);
+  ASSERT_EQ(run, runs);
+}
+
+// a timer service using a timing wheel fires its timers never before their
+// deadline, across the levels of the wheel, and cancels them in O(1)
+TEST(deferredThreadScheduler, test_22)
+{
+  auto origin = timerClock::now();
+  timingWheelTimerQueue twq {1ms, origin};
+  std::vector<timerQueue::slotIndex> expired {};
+
+  // deadlines landing in the first three levels and the due list
+  const std::vector<std::chrono::milliseconds> delays {0ms, 5ms, 255ms, 256ms, 300ms, 70'000ms, 65'536ms};
+  for (std::size_t i {}; i < delays.size(); ++i)
+  {
+    twq.push(static_cast<timerQueue::slotIndex>(i), origin + delays[i]);
+  }
+  twq.push(100, origin + 1'000ms);
+  twq.erase(100, origin + 1'000ms);
+  ASSERT_EQ(delays.size(), twq.size());
+
+  for (auto now = origin; now <= origin + 70'001ms; now += 1ms)
+  {
+    auto before = expired.size();
+    ASSERT_EQ(true, twq.empty() || (twq.nextDeadline() <= origin + 70'000ms));
+    twq.popExpired(now, expired);
+    for (auto i {before}; i < expired.size(); ++i)
+    {
+      ASSERT_EQ(true, expired[i] < delays.size());
+      // never early nor late, as the deadlines are multiples of the tick
+      ASSERT_EQ(true, origin + delays[expired[i]] == now);
+    }
+  }
+  ASSERT_EQ(delays.size(), expired.size());
+  ASSERT_EQ(true, twq.empty());
+
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsUniquePtr = std::unique_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  timerService ts {std::make_unique<timingWheelTimerQueue>(1ms)};
+  std::vector<dtsUniquePtr> v {};
+  const int numThreads {1'000};
+
+  for (int i {1}; i <= numThreads; ++i)
+  {
+    v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("intFoo"));
+    v.back()->registerThread([i]() noexcept(false) -> threadResultType
+                             {
+                               return i;
+                             }).useTimerService(ts);
+  }
+  auto start = timerClock::now();
+  for (int i {}; i < numThreads; ++i)
+  {
+    v[static_cast<std::size_t>(i)]->runIn(std::chrono::milliseconds((i % 2) ? 3'600'000 : i % 100));
+  }
+  for (int i {}; i < numThreads; i += 2)
+  {
+    auto [threadState, threadResult] = v[static_cast<std::size_t>(i)]->wait();
+    ASSERT_EQ(v[static_cast<std::size_t>(i)]->isRun(threadState), true);
+    ASSERT_EQ(i + 1, threadResult);
+  }
+  ASSERT_EQ(true, timerClock::now() - start >= 98ms);
+  ASSERT_EQ(numThreads / 2, ts.pendingTimers());
+  for (int i {1}; i < numThreads; i += 2)
+  {
+    ASSERT_EQ(true, v[static_cast<std::size_t>(i)]->cancelThread());
+  }
+  ASSERT_EQ(0, ts.pendingTimers());
+}
+
+// the 4-ary heap expires the same timers as the ordered queue, in deadline
+// order, whatever the sequence of push and erase
+TEST(deferredThreadScheduler, test_23)
+{
+  dAryHeapTimerQueue heap {};
+  orderedTimerQueue ordered {};
+  std::map<timerQueue::slotIndex, timerDeadline> pending {};
+  std::vector<timerQueue::slotIndex> heapExpired {};
+  std::vector<timerQueue::slotIndex> orderedExpired {};
+  std::mt19937 rng {42};
+  auto now = timerClock::now();
+  timerQueue::slotIndex nextSlot {};
+
+  for (int step {}; step < 100'000; ++step)
+  {
+    if ( auto op = rng() % 4;
+         op < 2 )
+    {
+      auto deadline = now + std::chrono::microseconds(rng() % 10'000);
+      heap.push(nextSlot, deadline);
+      ordered.push(nextSlot, deadline);
+      pending[nextSlot++] = deadline;
+    }
+    else if ( (2 == op) && (false == pending.empty()) )
+    {
+      auto it = pending.lower_bound(static_cast<timerQueue::slotIndex>(rng() % nextSlot));
+      if ( pending.end() == it )
+      {
+        it = pending.begin();
+      }
+      heap.erase(it->first, it->second);
+      ordered.erase(it->first, it->second);
+      pending.erase(it);
+    }
+    else
+    {
+      now += std::chrono::microseconds(rng() % 200);
+      heap.popExpired(now, heapExpired);
+      ordered.popExpired(now, orderedExpired);
+      for (auto slot : heapExpired)
+      {
+        pending.erase(slot);
+      }
+      // equal deadlines are expired in any order
+      std::sort(heapExpired.begin(), heapExpired.end());
+      std::sort(orderedExpired.begin(), orderedExpired.end());
+      ASSERT_EQ(orderedExpired, heapExpired);
+      heapExpired.clear();
+      orderedExpired.clear();
+    }
+    ASSERT_EQ(pending.size(), heap.size());
+    if ( false == heap.empty() )
+    {
+      ASSERT_EQ(ordered.nextDeadline(), heap.nextDeadline());
+    }
+  }
+
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsUniquePtr = std::unique_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  timerService ts {std::make_unique<dAryHeapTimerQueue>()};
+  std::vector<dtsUniquePtr> v {};
+  const int numThreads {1'000};
+
+  for (int i {}; i < numThreads; ++i)
+  {
+    v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("intFoo"));
+    v.back()->registerThread([i]() noexcept(false) -> threadResultType
+                             {
+                               return i;
+                             }).useTimerService(ts).runIn(std::chrono::milliseconds((i % 2) ? 3'600'000 : i % 50));
+  }
+  for (int i {1}; i < numThreads; i += 2)
+  {
+    ASSERT_EQ(true, v[static_cast<std::size_t>(i)]->cancelThread());
+  }
+  for (int i {}; i < numThreads; ++i)
+  {
+    auto [threadState, threadResult] = v[static_cast<std::size_t>(i)]->wait();
+    ASSERT_EQ(true, (i % 2) ? v[static_cast<std::size_t>(i)]->isCanceled(threadState)
+                            : v[static_cast<std::size_t>(i)]->isRun(threadState) && (i == threadResult));
+  }
+  ASSERT_EQ(0, ts.pendingTimers());
+}
+
+// a batch of instances is armed with a single call, under one lock of their
+// timer service
+TEST(deferredThreadScheduler, test_24)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsUniquePtr = std::unique_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  workerPool wp {4};
+  timerService ts {wp};
+  std::vector<dtsUniquePtr> v {};
+  const int numThreads {10'000};
+
+  for (int i {}; i < numThreads; ++i)
+  {
+    v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("intFoo"));
+    v.back()->registerThread([i]() noexcept(false) -> threadResultType
+                             {
+                               return i;
+                             }).useTimerService(ts);
+  }
+  // not registered: skipped by the batch
+  v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("notRegistered"));
+  v.back()->useTimerService(ts);
+
+  auto ids = deferredThreadScheduler<threadResultType, threadFun>::runAllIn(v, 200ms);
+
+  ASSERT_EQ(v.size(), ids.size());
+  ASSERT_EQ(timerService::invalidTimerId, ids.back());
+  ASSERT_EQ(numThreads, std::set<timerService::timerId>(ids.begin(), ids.end() - 1).size());
+  ASSERT_EQ(numThreads, ts.pendingTimers());
+  for (int i {}; i < numThreads; i += 3)
+  {
+    ASSERT_EQ(true, v[static_cast<std::size_t>(i)]->cancelThread());
+  }
+  for (int i {}; i < numThreads; ++i)
+  {
+    auto [threadState, threadResult] = v[static_cast<std::size_t>(i)]->wait();
+    ASSERT_EQ(true, (0 == i % 3) ? v[static_cast<std::size_t>(i)]->isCanceled(threadState)
+                                 : v[static_cast<std::size_t>(i)]->isRun(threadState) && (i == threadResult));
+  }
+  ASSERT_EQ(false, v.back()->isScheduled());
+  ASSERT_EQ(0, ts.pendingTimers());
+}
+
+// instances scheduled at the same absolute deadline, on the steady and on the
+// system clock, never run before it
+TEST(deferredThreadScheduler, test_25)
+{
+  using threadResultType = timerClock::time_point;
+  using threadFun = std::function<threadResultType()>;
+  using dtsUniquePtr = std::unique_ptr<deferredThreadScheduler<threadResultType, threadFun>>;
+  threadFun now = []() noexcept(false) -> threadResultType
+                  {
+                    return timerClock::now();
+                  };
+  std::vector<dtsUniquePtr> v {};
+
+  for (int i {}; i < 20; ++i)
+  {
+    v.push_back(makeUniqueDeferredThreadScheduler<threadResultType, threadFun>("now"));
+    v.back()->registerThread(now);
+    if ( 0 == i % 2 )
+    {
+      v.back()->useTimerService();
+    }
+  }
+
+  auto deadline = timerClock::now() + 300ms;
+  for (auto& dts : v)
+  {
+    dts->runAt(deadline);
+    std::this_thread::sleep_for(5ms);
+  }
+  for (auto& dts : v)
+  {
+    auto [threadState, threadResult] = dts->wait();
+    ASSERT_EQ(dts->isRun(threadState), true);
+    ASSERT_EQ(true, threadResult >= deadline);
+    // the time spent before runAt() is not added to the deadline
+    ASSERT_EQ(true, threadResult < deadline + 90ms);
+  }
+
+  auto wallDeadline = std::chrono::system_clock::now() + 200ms;
+  deferredThreadScheduler<threadResultType, threadFun> dts1 {"now"};
+  deferredThreadScheduler<threadResultType, threadFun> dts2 {"now"};
+  dts1.registerThread(now).runAt(wallDeadline);
+  dts2.registerThread(now).useTimerService().runAt(wallDeadline);
+  auto [threadState1, threadResult1] = dts1.wait();
+  auto [threadState2, threadResult2] = dts2.wait();
+  ASSERT_EQ(dts1.isRun(threadState1), true);
+  ASSERT_EQ(dts2.isRun(threadState2), true);
+  ASSERT_EQ(true, std::chrono::system_clock::now() >= wallDeadline);
+}
+
+// periodic tasks, on a thread of their own and on a timer service, run until
+// canceled, also while running, and count their executions and missed periods
+TEST(deferredThreadScheduler, test_26)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using periodicMode = deferredThreadSchedulerBase::periodicMode;
+  workerPool wp {2};
+  std::atomic<int> beats1 {0};
+  std::atomic<int> beats2 {0};
+
+  deferredThreadScheduler<threadResultType, threadFun> dts1 {"heartbeat"};
+  deferredThreadScheduler<threadResultType, threadFun> dts2 {"heartbeat", wp};
+  dts1.registerThread([&beats1]() noexcept(false) -> threadResultType
+                      {
+                        return ++beats1;
+                      }).runEvery(20ms);
+  dts2.registerThread([&beats2]() noexcept(false) -> threadResultType
+                      {
+                        return ++beats2;
+                      }).runEvery(20ms, periodicMode::fixedDelay);
+  ASSERT_EQ(true, dts1.isPeriodic());
+  ASSERT_EQ(true, dts2.isPeriodic());
+  while ( (beats1 < 5) || (beats2 < 5) )
+  {
+    std::this_thread::sleep_for(1ms);
+    ASSERT_EQ(false, dts1.isRun() || dts2.isRun());
+  }
+  ASSERT_EQ(true, dts1.cancelThread());
+  ASSERT_EQ(true, dts2.cancelThread());
+  auto [threadState1, threadResult1] = dts1.wait();
+  auto [threadState2, threadResult2] = dts2.wait();
+  ASSERT_EQ(dts1.isCanceled(threadState1), true);
+  ASSERT_EQ(dts2.isCanceled(threadState2), true);
+  std::this_thread::sleep_for(50ms);
+  ASSERT_EQ(beats1, dts1.getExecutions());
+  ASSERT_EQ(beats2, dts2.getExecutions());
+  ASSERT_EQ(0, dts2.getMissedPeriods());
+
+  // the runs overrunning their period: the missed periods are skipped and a
+  // cancel while running stops the task once the run ends
+  for (auto ts : {static_cast<timerService*>(nullptr), &timerService::defaultTimerService()})
+  {
+    std::atomic<int> runs {0};
+    deferredThreadScheduler<threadResultType, threadFun> dts {"slowbeat"};
+
+    if ( nullptr != ts )
+    {
+      dts.useTimerService(*ts);
+    }
+    dts.registerThread([&runs]() noexcept(false) -> threadResultType
+                       {
+                         ++runs;
+                         std::this_thread::sleep_for(35ms);
+                         return runs;
+                       }).runEvery(10ms);
+    while ( runs < 3 )
+    {
+      std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(true, dts.isRunning());
+    ASSERT_EQ(true, dts.cancelThread());
+    auto [threadState, threadResult] = dts.wait();
+    ASSERT_EQ(dts.isCanceled(threadState), true);
+    ASSERT_EQ(3, dts.getExecutions());
+    ASSERT_EQ(true, dts.getMissedPeriods() >= 2 * 2);
+  }
+
+  // destroyed while scheduled
+  {
+    deferredThreadScheduler<threadResultType, threadFun> dts {"heartbeat", wp};
+    dts.registerThread([]() noexcept(false) -> threadResultType
+                       {
+                         return 0;
+                       }).runEvery(1h);
+  }
+}
+
+// with a slack, timers due close to each other fire together in a few rounds
+// of the timer thread, never before their deadline
+TEST(deferredThreadScheduler, test_27)
+{
+  workerPool wp {2};
+  timerService ts {wp};
+  const int numTimers {1'000};
+  std::atomic<int> fired {0};
+  std::atomic<int> early {0};
+
+  ts.setSlack(20ms);
+  ASSERT_EQ(std::chrono::nanoseconds(20ms), ts.getSlack());
+
+  auto start = timerClock::now() + 10ms;
+  std::vector<timerService::timerRequest> requests {};
+  for (int i {}; i < numTimers; ++i)
+  {
+    auto deadline = start + std::chrono::microseconds(10 * i);
+    requests.push_back({deadline,
+                        [deadline, &fired, &early] ()
+                        {
+                          early += (timerClock::now() < deadline) ? 1 : 0;
+                          ++fired;
+                        },
+                        nullptr});
+  }
+  ts.schedule(std::move(requests));
+  while ( fired < numTimers )
+  {
+    std::this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(0, early);
+  // the 10ms spread of the deadlines is within the slack
+  ASSERT_EQ(true, ts.firingRounds() <= 2);
+}
+
+// the timer service measures how late its timers fire, whatever the backend
+TEST(deferredThreadScheduler, test_28)
+{
+  workerPool wp {1};
+  timerService ts {wp};
+  const std::size_t numTimers {100};
+  std::vector<timerService::timerRequest> requests {};
+
+  std::cout << "[ " << __func__ << " ] "
+            << "timer service backend: "
+            << timerService::backendName()
+            << std::endl;
+  auto start = timerClock::now() + 5ms;
+  for (std::size_t i {}; i < numTimers; ++i)
+  {
+    requests.push_back({start + std::chrono::microseconds(500 * i), [] () {}, nullptr});
+  }
+  ts.schedule(std::move(requests));
+  while ( ts.pendingTimers() > 0 )
+  {
+    std::this_thread::sleep_for(5ms);
+  }
+
+  auto stats = ts.firingLateness();
+  ASSERT_EQ(numTimers, stats.firedTimers);
+  ASSERT_EQ(true, stats.mean <= stats.max);
+  ASSERT_EQ(true, stats.max > 0ns);
+  ts.resetFiringLateness();
+  ASSERT_EQ(0, ts.firingLateness().firedTimers);
+}
+
+// in precision mode tasks never start before their deadline, also when the
+// cap on spinning threads makes them wait on the clock instead
+TEST(deferredThreadScheduler, test_29)
+{
+  using threadResultType = timerClock::time_point;
+  using threadFun = std::function<threadResultType()>;
+  threadFun now = []() noexcept(false) -> threadResultType
+                  {
+                    return timerClock::now();
+                  };
+  auto maxSpinningThreads = deferredThreadSchedulerBase::getMaxSpinningThreads();
+
+  for (auto spinners : {maxSpinningThreads, 0u})
+  {
+    deferredThreadSchedulerBase::setMaxSpinningThreads(spinners);
+    for (int i {}; i < 10; ++i)
+    {
+      deferredThreadScheduler<threadResultType, threadFun> dts1 {"now"};
+      deferredThreadScheduler<threadResultType, threadFun> dts2 {"now"};
+      auto deadline = timerClock::now() + 5ms;
+
+      dts1.registerThread(now).usePrecisionMode(500us).runAt(deadline);
+      dts2.registerThread(now).useTimerService().usePrecisionMode(500us).runAt(deadline);
+      auto [threadState1, threadResult1] = dts1.wait();
+      auto [threadState2, threadResult2] = dts2.wait();
+      ASSERT_EQ(dts1.isRun(threadState1), true);
+      ASSERT_EQ(dts2.isRun(threadState2), true);
+      ASSERT_EQ(true, threadResult1 >= deadline);
+      ASSERT_EQ(true, threadResult2 >= deadline);
+    }
+    ASSERT_EQ(0, deferredThreadSchedulerBase::getSpinningThreads());
+  }
+  deferredThreadSchedulerBase::setMaxSpinningThreads(maxSpinningThreads);
+
+  // canceled while spinning
+  deferredThreadScheduler<threadResultType, threadFun> dts {"now"};
+  dts.registerThread(now).usePrecisionMode(1s).runIn(1s);
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(1, deferredThreadSchedulerBase::getSpinningThreads());
+  ASSERT_EQ(true, dts.cancelThread());
+  auto [threadState, threadResult] = dts.wait();
+  ASSERT_EQ(dts.isCanceled(threadState), true);
+  // the spinning thread stops as soon as it sees the cancellation
+  for (int i {}; (i < 100) && (0 != deferredThreadSchedulerBase::getSpinningThreads()); ++i)
+  {
+    std::this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(0, deferredThreadSchedulerBase::getSpinningThreads());
+
+  // canceled while waiting the margin on the clock, with a timer service: the
+  // fired job, which the dtor waits for, wakes up at once
+  deferredThreadSchedulerBase::setMaxSpinningThreads(0);
+  auto canceledAt = timerClock::now();
+  {
+    deferredThreadScheduler<threadResultType, threadFun> dts3 {"now"};
+    dts3.registerThread(now).useTimerService().usePrecisionMode(60s).runIn(60s);
+    std::this_thread::sleep_for(100ms);
+    canceledAt = timerClock::now();
+    ASSERT_EQ(true, dts3.cancelThread());
+    auto [threadState3, threadResult3] = dts3.wait();
+    ASSERT_EQ(dts3.isCanceled(threadState3), true);
+  }
+  ASSERT_EQ(true, timerClock::now() - canceledAt < 1s);
+  deferredThreadSchedulerBase::setMaxSpinningThreads(maxSpinningThreads);
+}
+
+// the arguments are copied at registration, so temporaries and arguments
+// going out of scope are safe; typical callables are stored with no heap
+// allocation, and move-only ones are accepted
+TEST(deferredThreadScheduler, test_30)
+{
+  using threadResultType = std::string;
+  using threadFun = std::function<threadResultType(const std::string&, const std::string&)>;
+
+  threadFun concatStrings = [](const auto& str1, const auto& str2)
+                            {
+                              return str1 + str2;
+                            };
+
+  deferredThreadScheduler<threadResultType, threadFun> dts1 {"concatStrings"};
+  {
+    std::string s1 {"Hello "};
+    dts1.registerThread(concatStrings, s1, std::string {"World!!!"});
+    s1 = "Goodbye ";
+  }
+  auto [threadState1, threadResult1] = dts1.runIn(10ms).wait();
+  ASSERT_EQ(dts1.isRun(threadState1), true);
+  ASSERT_EQ("Hello World!!!", threadResult1);
+
+  // std::ref() passes a reference
+  std::string s2 {"Hello "};
+  deferredThreadScheduler<threadResultType, threadFun> dts2 {"concatStrings"};
+  dts2.registerThread(concatStrings, std::ref(s2), std::string {"World!!!"});
+  s2 = "Goodbye ";
+  auto [threadState2, threadResult2] = dts2.runIn(0s).wait();
+  ASSERT_EQ(dts2.isRun(threadState2), true);
+  ASSERT_EQ("Goodbye World!!!", threadResult2);
+
+  using task = inplaceTask<int()>;
+  auto p = std::make_unique<int>(42);
+  task t1 {[p = std::move(p)] () { return *p; }};
+  ASSERT_EQ(true, t1.isInline());
+  task t2 {std::move(t1)};
+  ASSERT_EQ(false, static_cast<bool>(t1));
+  ASSERT_EQ(42, t2());
+
+  std::array<char, 2 * task::capacity> big {'a'};
+  task t3 {[big] () { return static_cast<int>(big[0]); }};
+  ASSERT_EQ(false, t3.isInline());
+  t2 = std::move(t3);
+  ASSERT_EQ(static_cast<int>('a'), t2());
+  ASSERT_THROW(t3(), std::bad_function_call);
+
+  // a lambda capturing a few values needs no heap allocation
+  int i {1};
+  int j {2};
+  auto lambda = [i, j] () { return i + j; };
+  ASSERT_EQ(true, task::isStoredInline<decltype(lambda)>);
+}
+
+// void thread functions, and results that are move-only, not default
+// constructible or counting their copies, moved out once by take()
+TEST(deferredThreadScheduler, test_31)
+{
+  std::atomic<int> runs {0};
+  deferredThreadScheduler<void> dtsVoid {"void"};
+  auto [voidState, voidResult] = dtsVoid.registerThread([&runs] ()
+                                                        {
+                                                          TERMINATE_ON_CANCELLATION(void)
+                                                          ++runs;
+                                                        }).runIn(0s).wait();
+  ASSERT_EQ(dtsVoid.isRun(voidState), true);
+  ASSERT_EQ(1, runs.load());
+  ASSERT_EQ(std::monostate {}, voidResult);
+
+  using uniquePtrFun = std::function<std::unique_ptr<int>()>;
+  deferredThreadScheduler<std::unique_ptr<int>, uniquePtrFun> dtsPtr {"uniquePtr"};
+  dtsPtr.registerThread([] () { return std::make_unique<int>(42); }).useTimerService().runIn(0s);
+  auto [ptrState, ptrResult] = dtsPtr.take();
+  ASSERT_EQ(dtsPtr.isRun(ptrState), true);
+  ASSERT_EQ(true, ptrResult.has_value());
+  ASSERT_EQ(42, **ptrResult);
+  // taken exactly once
+  auto [ptrStateAgain, ptrResultAgain] = dtsPtr.take();
+  ASSERT_EQ(dtsPtr.isRun(ptrStateAgain), true);
+  ASSERT_EQ(false, ptrResultAgain.has_value());
+
+  struct noDefault
+  {
+    explicit noDefault(int v) : value (v) {}
+    int value;
+  };
+  using noDefaultFun = std::function<noDefault(int)>;
+  deferredThreadScheduler<noDefault, noDefaultFun> dtsNoDefault {"noDefault"};
+  auto [noDefaultState, noDefaultResult] = dtsNoDefault.registerThread([] (int v) { return noDefault {v}; }, 7).runIn(0s).take();
+  ASSERT_EQ(dtsNoDefault.isRun(noDefaultState), true);
+  ASSERT_EQ(7, noDefaultResult->value);
+
+  static std::atomic<int> copies {0};
+  struct payload
+  {
+    payload() : data (1'000'000, 1) {}
+    payload(const payload& rhs) : data (rhs.data) { ++copies; }
+    payload(payload&& rhs) noexcept = default;
+    payload& operator=(const payload& rhs) { data = rhs.data; ++copies; return *this; }
+    payload& operator=(payload&& rhs) noexcept = default;
+    ~payload() = default;
+    std::vector<int> data;
+  };
+  using payloadFun = std::function<payload()>;
+  deferredThreadScheduler<payload, payloadFun> dtsPayload {"payload"};
+  auto [payloadState, payloadResult] = dtsPayload.registerThread([] () { return payload {}; }).runIn(0s).take();
+  ASSERT_EQ(dtsPayload.isRun(payloadState), true);
+  ASSERT_EQ(1'000'000u, payloadResult->data.size());
+  ASSERT_EQ(0, copies.load());
+}
+
+// a terminated instance is reset and scheduled again, and a pending timeout
+// is re-armed over and over, reusing the same instance
+TEST(deferredThreadScheduler, test_32)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  std::atomic<int> runs {0};
+
+  deferredThreadScheduler<threadResultType, threadFun> dts {"intFoo"};
+  // nothing to reset before registration
+  ASSERT_EQ(false, dts.reset().isRegistered());
+  dts.registerThread([&runs]() noexcept(false) -> threadResultType { return ++runs; });
+  for (auto i {1}; i <= 3; ++i)
+  {
+    auto [threadState, threadResult] = dts.rearm(1ms).wait();
+    ASSERT_EQ(dts.isRun(threadState), true);
+    ASSERT_EQ(i, threadResult);
+  }
+  ASSERT_EQ(3u, dts.getExecutions());
+  ASSERT_EQ(true, dts.reset().isRegistered());
+
+  // a watchdog re-armed before it expires keeps a single pending timer
+  timerService ts {};
+  deferredThreadScheduler<threadResultType, threadFun> watchdog {"watchdog"};
+  watchdog.useTimerService(ts).registerThread([&runs]() noexcept(false) -> threadResultType { return ++runs; });
+  for (auto i {0}; i < 100; ++i)
+  {
+    watchdog.rearm(std::chrono::seconds(1h));
+    ASSERT_EQ(true, watchdog.isScheduled());
+    ASSERT_EQ(1u, ts.pendingTimers());
+  }
+  auto [threadState, threadResult] = watchdog.rearm(timerClock::now()).wait();
+  ASSERT_EQ(watchdog.isRun(threadState), true);
+  ASSERT_EQ(4, threadResult);
+  ASSERT_EQ(1u, watchdog.getExecutions());
+  ASSERT_EQ(0u, ts.pendingTimers());
+
+  // the stop token of a canceled periodic task is cleared by reset()
+  deferredThreadScheduler<threadResultType, threadFun> heartbeat {"heartbeat"};
+  heartbeat.registerThread([]() noexcept(false) -> threadResultType { return 1; }).runEvery(1ms);
+  std::this_thread::sleep_for(10ms);
+  heartbeat.cancelThread();
+  heartbeat.reset();
+  ASSERT_EQ(true, heartbeat.isRegistered());
+  ASSERT_EQ(false, heartbeat.isPeriodic());
+  ASSERT_EQ(false, heartbeat.getStopToken().stopRequested());
+  auto [heartbeatState, heartbeatResult] = heartbeat.runIn(0s).wait();
+  ASSERT_EQ(heartbeat.isRun(heartbeatState), true);
+  ASSERT_EQ(1, heartbeatResult);
+}
+
+// the instances of a pool are recycled in the same slots, and handles to a
+// released instance are stale
+TEST(deferredThreadScheduler, test_33)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using pool = deferredThreadSchedulerPool<threadResultType, threadFun>;
+  pool p {};
+
+  auto h1 = p.acquire("intFoo");
+  auto [threadState, threadResult] = h1->registerThread([]() noexcept(false) -> threadResultType { return 1; }).runIn(0s).wait();
+  ASSERT_EQ(h1->isRun(threadState), true);
+  ASSERT_EQ(1, threadResult);
+  ASSERT_EQ(1u, p.size());
+
+  auto address = h1.get();
+  auto copy = h1;
+  ASSERT_EQ(true, p.release(h1));
+  ASSERT_EQ(false, p.release(copy));
+  ASSERT_EQ(false, copy.valid());
+  ASSERT_EQ(nullptr, copy.get());
+  ASSERT_THROW(copy->isRun(), std::logic_error);
+  ASSERT_EQ(0u, p.size());
+
+  // the slot is reused by the next instance, which old handles do not reach
+  auto h2 = p.acquire("intFoo");
+  ASSERT_EQ(address, h2.get());
+  ASSERT_EQ(false, h1.valid());
+  ASSERT_EQ(false, h2->isRegistered());
+
+  // pending tasks are canceled on release, and in the steady state the pool
+  // allocates no more slots
+  auto capacity = p.capacity();
+  for (auto round {0}; round < 10; ++round)
+  {
+    std::vector<pool::handle> handles {};
+    for (std::size_t i {1}; i < pool::slotsPerChunk; ++i)
+    {
+      handles.push_back(p.acquire("intFoo"));
+      handles.back()->useTimerService().registerThread([]() noexcept(false) -> threadResultType { return 1; }).runIn(std::chrono::seconds(1h));
+    }
+    for (auto& h : handles)
+    {
+      ASSERT_EQ(true, p.release(h));
+    }
+  }
+  ASSERT_EQ(capacity, p.capacity());
+  ASSERT_EQ(1u, p.size());
+}
+
+// continuations get the result by move when the task completes, right away
+// on its thread or after a delay, and chain tasks with no thread waiting
+TEST(deferredThreadScheduler, test_34)
+{
+  using threadResultType = std::unique_ptr<int>;
+  using threadFun = std::function<threadResultType()>;
+
+  std::promise<std::pair<int, std::thread::id>> p1 {};
+  deferredThreadScheduler<threadResultType, threadFun> dts1 {"makeInt"};
+  dts1.registerThread([] () { return std::make_unique<int>(1); })
+      .then([&p1] (threadResultType&& r) { p1.set_value({*r, std::this_thread::get_id()}); })
+      .runIn(0s);
+  auto [value1, threadId1] = p1.get_future().get();
+  ASSERT_EQ(1, value1);
+  auto [threadState1, threadResult1] = dts1.take();
+  ASSERT_EQ(dts1.isRun(threadState1), true);
+  ASSERT_EQ(threadId1, dts1.getThreadId());
+  // the continuation took the result
+  ASSERT_EQ(false, threadResult1.has_value());
+
+  // run the continuation 50ms after the task finishes
+  std::promise<timerDeadline> p2 {};
+  timerDeadline finished {};
+  deferredThreadScheduler<threadResultType, threadFun> dts2 {"makeInt"};
+  dts2.registerThread([&finished] ()
+                      {
+                        finished = timerClock::now();
+                        return std::make_unique<int>(2);
+                      })
+      .useTimerService()
+      .then([&p2] (threadResultType&& r) { p2.set_value((2 == *r) ? timerClock::now() : timerDeadline {}); }, 50ms)
+      .runIn(0s);
+  auto called = p2.get_future().get();
+  ASSERT_EQ(true, called >= finished + 50ms);
+
+  // a pipeline of three steps, each started by the continuation of the
+  // previous one
+  using intFun = std::function<int()>;
+  std::promise<int> p3 {};
+  deferredThreadScheduler<int, intFun> step1 {"step1"};
+  deferredThreadScheduler<int, intFun> step2 {"step2"};
+  deferredThreadScheduler<void> step3 {"step3"};
+  std::atomic<int> carried {0};
+  step3.registerThread([&p3, &carried] () { p3.set_value(carried.load() * 10); });
+  step2.registerThread([&carried] () { return carried.load() + 1; })
+       .then([&carried, &step3] (int r) { carried = r; step3.useTimerService().runIn(0s); });
+  step1.registerThread([] () { return 1; })
+       .then([&carried, &step2] (int r) { carried = r; step2.runIn(1ms); })
+       .runIn(0s);
+  ASSERT_EQ(20, p3.get_future().get());
+  ASSERT_EQ(true, step3.isRun(std::get<0>(step3.wait())));
+
+  // a canceled task does not call its continuation
+  std::atomic<bool> continued {false};
+  deferredThreadScheduler<int, intFun> dts4 {"canceled"};
+  dts4.registerThread([] () { return 4; })
+      .then([&continued] (int) { continued = true; })
+      .runIn(std::chrono::seconds(1h));
+  ASSERT_EQ(true, dts4.cancelThread());
+  auto [threadState4, threadResult4] = dts4.wait();
+  ASSERT_EQ(dts4.isCanceled(threadState4), true);
+  ASSERT_EQ(false, continued.load());
+}
+
+// the nodes of a task graph run after their deadline and their predecessors,
+// and canceling or failing a node cancels its dependents
+TEST(deferredThreadScheduler, test_35)
+{
+  using nodeState = taskGraph::nodeState;
+  workerPool wp {4};
+  timerService ts {wp};
+
+  // C runs at T+200ms, but only after A and B
+  {
+    taskGraph g {ts};
+    std::atomic<int> done {0};
+    timerDeadline cStarted {};
+    auto deadline = timerClock::now() + 200ms;
+    auto a = g.addNode([&done] () { std::this_thread::sleep_for(50ms); ++done; });
+    auto b = g.addNode([&done] () { std::this_thread::sleep_for(300ms); ++done; });
+    auto c = g.addNode([&done, &cStarted] ()
+                       {
+                         cStarted = timerClock::now();
+                         ASSERT_EQ(2, done.load());
+                       },
+                       deadline);
+    ASSERT_EQ(true, g.addDependency(a, c));
+    ASSERT_EQ(true, g.addDependency(b, c));
+    ASSERT_EQ(true, g.start());
+    g.wait();
+    ASSERT_EQ(nodeState::Run, g.getNodeState(c));
+    ASSERT_EQ(true, cStarted >= deadline + 100ms);
+  }
+
+  // a random graph of hundreds of nodes: every node runs after its
+  // predecessors
+  {
+    constexpr std::size_t n {500};
+    taskGraph g {ts};
+    std::mt19937 rng {7};
+    std::atomic<int> sequence {0};
+    std::vector<int> order (n, -1);
+    std::vector<std::pair<std::size_t, std::size_t>> edges {};
+    auto now = timerClock::now();
+
+    for (std::size_t i {}; i < n; ++i)
+    {
+      g.addNode([&sequence, &order, i] () { order[i] = sequence++; },
+                (0 == i % 7) ? now + std::chrono::milliseconds(i % 50) : timerDeadline {});
+    }
+    for (std::size_t j {1}; j < n; ++j)
+    {
+      for (auto k {0}; k < 3; ++k)
+      {
+        auto i = std::uniform_int_distribution<std::size_t> {0, j - 1}(rng);
+        edges.emplace_back(i, j);
+        ASSERT_EQ(true, g.addDependency(i, j));
+      }
+    }
+    ASSERT_EQ(true, g.start());
+    g.wait();
+    for (auto [i, j] : edges)
+    {
+      ASSERT_EQ(true, order[i] < order[j]);
+    }
+  }
+
+  // canceling a node cancels its dependents; a throwing node too
+  {
+    taskGraph g {ts};
+    std::atomic<int> runs {0};
+    auto x = g.addNode([&runs] () { ++runs; }, timerClock::now() + 1h);
+    auto y = g.addNode([&runs] () { ++runs; });
+    auto z = g.addNode([&runs] () { ++runs; });
+    auto t = g.addNode([] () { throw std::runtime_error("node failed"); });
+    auto u = g.addNode([&runs] () { ++runs; });
+    auto v = g.addNode([&runs] () { ++runs; });
+    g.addDependency(x, y);
+    g.addDependency(y, z);
+    g.addDependency(t, u);
+    ASSERT_EQ(true, g.start());
+    ASSERT_EQ(1u, ts.pendingTimers());
+    ASSERT_EQ(true, g.cancel(x));
+    ASSERT_EQ(false, g.cancel(x));
+    g.wait();
+    ASSERT_EQ(0u, ts.pendingTimers());
+    ASSERT_EQ(nodeState::Canceled, g.getNodeState(y));
+    ASSERT_EQ(nodeState::Canceled, g.getNodeState(z));
+    ASSERT_EQ(nodeState::ExceptionThrown, g.getNodeState(t));
+    ASSERT_EQ("node failed", g.getExceptionThrownMessage(t));
+    ASSERT_EQ(nodeState::Canceled, g.getNodeState(u));
+    ASSERT_EQ(nodeState::Run, g.getNodeState(v));
+    ASSERT_EQ(1, runs.load());
+  }
+
+  // a cycle is refused
+  {
+    taskGraph g {ts};
+    auto a = g.addNode([] () {});
+    auto b = g.addNode([] () {});
+    g.addDependency(a, b);
+    g.addDependency(b, a);
+    ASSERT_EQ(false, g.start());
+  }
+}
+
+// a terminated task is reported through its completion callback and through
+// a completion queue shared by many instances
+TEST(deferredThreadScheduler, test_36)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  using threadState = deferredThreadSchedulerBase::threadState;
+  threadFun answer = [] () { return 42; };
+  threadFun fails = [] () -> threadResultType { throw std::runtime_error("task failed"); };
+
+  // the callback learns every way a task terminates, with its result if any
+  {
+    std::atomic<int> state {-1};
+    std::atomic<int> result {-1};
+    auto done = [&state, &result] (baseThreadStateType ts, const threadResultType* r)
+                {
+                  result = (nullptr == r) ? 0 : *r;
+                  state = ts;
+                };
+
+    dtsType run {"run"};
+    run.registerThread(answer).onCompletion(done).runIn(10ms);
+    auto [ts, r] = run.wait();
+    ASSERT_EQ(true, run.isRun(ts));
+    ASSERT_EQ(static_cast<int>(threadState::Run), state.load());
+    ASSERT_EQ(42, result.load());
+    ASSERT_EQ(42, r);
+
+    dtsType canceled {"canceled"};
+    canceled.registerThread(answer).useTimerService().onCompletion(done).runIn(60s);
+    ASSERT_EQ(true, canceled.cancelThread());
+    ASSERT_EQ(static_cast<int>(threadState::Canceled), state.load());
+    ASSERT_EQ(0, result.load());
+
+    result = -1;
+    dtsType thrown {"thrown"};
+    thrown.registerThread(fails).onCompletion(done).runIn(10ms);
+    ASSERT_EQ(true, thrown.isExceptionThrown(std::get<0>(thrown.wait())));
+    ASSERT_EQ(static_cast<int>(threadState::ExceptionThrown), state.load());
+    ASSERT_EQ(0, result.load());
+    ASSERT_EQ("task failed", thrown.getExceptionThrownMessage());
+  }
+
+  // hundreds of instances report to one queue, drained without polling
+  {
+    constexpr std::size_t n {300};
+    workerPool wp {4};
+    completionQueue q {};
+    std::vector<std::unique_ptr<dtsType>> instances {};
+    std::vector<completionQueue::completion> done {};
+
+    for (std::size_t i {}; i < n; ++i)
+    {
+      instances.push_back(std::make_unique<dtsType>("dts" + std::to_string(i), wp));
+      instances.back()->registerThread((0 == i % 10) ? fails : answer).useCompletionQueue(q);
+    }
+    for (std::size_t i {}; i < n; ++i)
+    {
+      instances[i]->runIn(std::chrono::milliseconds(i % 50));
+    }
+    ASSERT_EQ(true, instances[1]->cancelThread() || instances[1]->isRun());
+    for (auto wakeups {0}; (done.size() < n) && (wakeups < 1000); ++wakeups)
+    {
+      q.waitAndDrain(done, 1s);
+    }
+    ASSERT_EQ(n, done.size());
+    ASSERT_EQ(true, q.empty());
+
+    std::set<const deferredThreadSchedulerBase*> seen {};
+    for (const auto& c : done)
+    {
+      seen.insert(c.dts);
+      ASSERT_EQ(c.dts->getThreadState(), c.state);
+    }
+    ASSERT_EQ(n, seen.size());
+  }
+
+  // concurrent producers: nothing lost, each producer's completions in order
+  {
+    constexpr int producers {4};
+    constexpr int perProducer {20000};
+    completionQueue q {};
+    std::array<std::unique_ptr<dtsType>, producers> ids {};
+    std::vector<std::thread> threads {};
+    std::vector<completionQueue::completion> done {};
+    std::map<const deferredThreadSchedulerBase*, int> next {};
+
+    for (auto& id : ids)
+    {
+      id = std::make_unique<dtsType>("producer");
+      next[id.get()] = 0;
+    }
+    for (auto p {0}; p < producers; ++p)
+    {
+      threads.emplace_back([&q, &ids, p] ()
+                           {
+                             for (auto k {0}; k < perProducer; ++k)
+                             {
+                               q.push({ids[static_cast<std::size_t>(p)].get(), k});
+                             }
+                           });
+    }
+    while ( done.size() < static_cast<std::size_t>(producers * perProducer) )
+    {
+      q.waitAndDrain(done, 10ms);
+    }
+    for (auto& t : threads)
+    {
+      t.join();
+    }
+    for (const auto& c : done)
+    {
+      ASSERT_EQ(next[c.dts]++, c.state);
+    }
+    ASSERT_EQ(0u, q.drain(done));
+  }
+}
+
+// wait_any() and wait_all() block on a range of instances until one or all
+// of them terminate, or until a time-out
+TEST(deferredThreadScheduler, test_37)
+{
+  using threadResultType = std::size_t;
+  using threadFun = std::function<threadResultType(std::size_t)>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  threadFun identity = [] (std::size_t i) { return i; };
+  workerPool wp {4};
+  timerService ts {wp};
+
+  // the first of a thousand tasks to terminate is found by one blocking wait
+  {
+    constexpr std::size_t n {1000};
+    constexpr std::size_t first {637};
+    std::vector<std::unique_ptr<dtsType>> instances {};
+
+    for (std::size_t i {}; i < n; ++i)
+    {
+      instances.push_back(std::make_unique<dtsType>("dts" + std::to_string(i)));
+      instances.back()->useTimerService(ts).registerThread(identity, i);
+      instances.back()->runIn((first == i) ? 50ms : 60s);
+    }
+    ASSERT_EQ(dtsType::noIndex, dtsType::wait_any(instances, 10ms));
+
+    auto start = timerClock::now();
+    auto i = dtsType::wait_any(instances, 10s);
+    ASSERT_EQ(first, i);
+    ASSERT_EQ(true, timerClock::now() - start < 5s);
+    auto [threadState, threadResult] = instances[i]->wait();
+    ASSERT_EQ(true, instances[i]->isRun(threadState));
+    ASSERT_EQ(first, threadResult);
+
+    // the time-out expires with just one terminated
+    ASSERT_EQ(std::vector<std::size_t> {first}, dtsType::wait_all(instances, 10ms));
+
+    // canceling terminates them all, each signaling the waiter once
+    std::thread canceler {[&instances] ()
+                          {
+                            std::this_thread::sleep_for(20ms);
+                            for (auto& dts : instances)
+                            {
+                              dts->cancelThread();
+                            }
+                          }};
+    auto done = dtsType::wait_all(instances);
+    canceler.join();
+    ASSERT_EQ(n, done.size());
+    for (std::size_t k {}; k < n; ++k)
+    {
+      ASSERT_EQ(k, done[k]);
+    }
+    // nothing left attached
+    ASSERT_EQ(0u, dtsType::wait_any(instances));
+  }
+
+  // instances on threads of their own, a range of instances
+  {
+    std::array<dtsType, 3> instances {dtsType {"a"}, dtsType {"b"}, dtsType {"c"}};
+
+    instances[0].registerThread(identity, 0).runIn(300ms);
+    instances[1].registerThread(identity, 1).runIn(30ms);
+    instances[2].registerThread(identity, 2).runIn(200ms);
+    ASSERT_EQ(1u, dtsType::wait_any(instances, 5s));
+    auto done = dtsType::wait_all(instances, 5s);
+    ASSERT_EQ((std::vector<std::size_t> {0, 1, 2}), done);
+    ASSERT_EQ(2u, std::get<1>(instances[2].wait()));
+  }
+
+  // an empty range does not block
+  {
+    std::vector<dtsType*> none {};
+    ASSERT_EQ(dtsType::noIndex, dtsType::wait_any(none));
+    ASSERT_EQ(true, dtsType::wait_all(none).empty());
+  }
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+// a coroutine started at once and awaited by no one
+struct detachedCoroutine
+{
+  struct promise_type
+  {
+    detachedCoroutine get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+#endif
+
+// co_await on an instance resumes the coroutine when the task terminates,
+// and sleep_for() parks it in the timer queue without blocking a thread
+TEST(deferredThreadScheduler, test_38)
+{
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType(int)>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  using resumption = std::tuple<baseThreadStateType, threadResultType, std::thread::id>;
+  threadFun twice = [] (int i) { return 2 * i; };
+  workerPool wp {2};
+  timerService ts {wp};
+
+  auto awaitTask = [] (const dtsType& dts,
+                       const std::chrono::milliseconds deferredTime,
+                       std::promise<resumption>& resumed) -> detachedCoroutine
+                   {
+                     auto [threadState, threadResult] = co_await dts.runIn(deferredTime);
+                     resumed.set_value({threadState, threadResult, std::this_thread::get_id()});
+                   };
+
+  // the coroutine resumes with the result, on the executor of the instance
+  {
+    dtsType dts {"awaited"};
+    std::promise<resumption> resumed {};
+    auto f = resumed.get_future();
+
+    dts.useTimerService(ts).registerThread(twice, 21);
+    awaitTask(dts, 100ms, resumed);
+    ASSERT_EQ(std::future_status::timeout, f.wait_for(0ms));
+    auto [threadState, threadResult, resumedBy] = f.get();
+    ASSERT_EQ(true, dts.isRun(threadState));
+    ASSERT_EQ(42, threadResult);
+    ASSERT_NE(std::this_thread::get_id(), resumedBy);
+  }
+
+  // the coroutine resumes without waiting for the continuation of the task,
+  // which gets the result
+  {
+    dtsType dts {"continued"};
+    std::promise<resumption> resumed {};
+    auto f = resumed.get_future().share();
+    std::atomic<bool> resumedFirst {false};
+
+    dts.useTimerService(ts)
+       .registerThread(twice, 21)
+       .then([f, &resumedFirst] (int) { resumedFirst = (std::future_status::ready == f.wait_for(10s)); });
+    awaitTask(dts, 10ms, resumed);
+    auto [threadState, threadResult, resumedBy] = f.get();
+    ASSERT_EQ(true, dts.isRun(threadState));
+    ASSERT_EQ(0, threadResult);
+    dts.wait();
+    ASSERT_EQ(true, resumedFirst.load());
+  }
+
+  // canceling the task resumes the coroutine too
+  {
+    dtsType dts {"canceled"};
+    std::promise<resumption> resumed {};
+    auto f = resumed.get_future();
+
+    dts.useTimerService(ts).registerThread(twice, 21);
+    awaitTask(dts, 60000ms, resumed);
+    ASSERT_EQ(true, dts.cancelThread());
+    ASSERT_EQ(true, dts.isCanceled(std::get<0>(f.get())));
+    ASSERT_EQ(0u, ts.pendingTimers());
+  }
+
+  // a thousand coroutines parked in the timer queue, no thread blocked
+  {
+    constexpr int n {1000};
+    std::atomic<int> woken {0};
+    std::promise<void> allWoken {};
+    auto f = allWoken.get_future();
+    auto sleeper = [] (timerService& ts,
+                       const std::chrono::milliseconds d,
+                       std::atomic<int>& woken,
+                       std::promise<void>& allWoken) -> detachedCoroutine
+                   {
+                     auto start = timerClock::now();
+                     co_await DTS::sleep_for(d, ts);
+                     EXPECT_EQ(true, timerClock::now() - start >= d);
+                     if ( n == ++woken )
+                     {
+                       allWoken.set_value();
+                     }
+                   };
+
+    for (auto i {0}; i < n; ++i)
+    {
+      sleeper(ts, std::chrono::milliseconds(20 + i % 50), woken, allWoken);
+    }
+    ASSERT_EQ(std::future_status::ready, f.wait_for(10s));
+    ASSERT_EQ(n, woken.load());
+  }
+#else
+  GTEST_SKIP() << "built without C++20 coroutines";
+#endif
+}
+
+// when the due tasks exceed the workers, the tasks of a higher priority start
+// first, and the queueing delay is measured per priority
+TEST(deferredThreadScheduler, test_39)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType(int)>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  constexpr int critical {5};
+  constexpr int bulk {20};
+  workerPool wp {1};
+  timerService ts {wp};
+  std::mutex mx {};
+  std::vector<int> order {};
+  threadFun record = [&mx, &order] (int i)
+                     {
+                       std::lock_guard<std::mutex> lg(mx);
+                       order.push_back(i);
+                       return i;
+                     };
+
+  // the only worker is kept busy while all the tasks become due
+  std::promise<void> gate {};
+  auto opened = gate.get_future().share();
+  wp.post([opened] () { opened.wait(); }, executor::lowestPriority);
+
+  std::vector<std::unique_ptr<dtsType>> instances {};
+  auto deadline = timerClock::now() + 20ms;
+  for (auto i {0}; i < critical + bulk; ++i)
+  {
+    // the bulk ones first: they are due first but must wait
+    auto p = (i < bulk) ? executor::lowestPriority : executor::highestPriority;
+    instances.push_back(std::make_unique<dtsType>("dts" + std::to_string(i)));
+    instances.back()->useTimerService(ts).setPriority(p).registerThread(record, i);
+    ASSERT_EQ(p, instances.back()->getPriority());
+  }
+  for (auto& dts : instances)
+  {
+    dts->runAt(deadline);
+  }
+  for (auto spins {0}; (wp.queuedTasks() < static_cast<std::size_t>(critical + bulk)) && (spins < 5000); ++spins)
+  {
+    std::this_thread::sleep_for(1ms);
+  }
+  ASSERT_EQ(static_cast<std::size_t>(bulk), wp.queuedTasks(executor::lowestPriority));
+  ASSERT_EQ(static_cast<std::size_t>(critical), wp.queuedTasks(executor::highestPriority));
+  gate.set_value();
+  ASSERT_EQ(critical + bulk - 1, dtsType::wait_all(instances).back());
+
+  // all the critical tasks ran before the bulk ones, each class in FIFO order
+  ASSERT_EQ(static_cast<std::size_t>(critical + bulk), order.size());
+  for (auto k {0}; k < critical; ++k)
+  {
+    ASSERT_EQ(true, order[static_cast<std::size_t>(k)] >= bulk);
+  }
+  ASSERT_EQ(true, std::is_sorted(order.begin() + critical, order.end()));
+
+  auto criticalDelay = wp.queueingDelay(executor::highestPriority);
+  auto bulkDelay = wp.queueingDelay(executor::lowestPriority);
+  ASSERT_EQ(static_cast<std::uint64_t>(critical), criticalDelay.tasks);
+  ASSERT_EQ(static_cast<std::uint64_t>(bulk + 1), bulkDelay.tasks);
+  ASSERT_EQ(true, bulkDelay.max >= criticalDelay.max);
+  wp.resetQueueingDelay();
+  ASSERT_EQ(0u, wp.queueingDelay(executor::lowestPriority).tasks);
+
+  // out of range priorities are the lowest
+  dtsType dts {"clamped"};
+  ASSERT_EQ(executor::lowestPriority, dts.setPriority(100).getPriority());
+
+  // the priority set before the executor applies to it too
+  dtsType late {"late"};
+  threadFun twice = [] (int i) { return 2 * i; };
+  late.setPriority(executor::lowestPriority).useExecutor(wp).registerThread(twice, 1).runIn(1ms);
+  ASSERT_EQ(2, std::get<1>(late.wait()));
+  ASSERT_EQ(1u, wp.queueingDelay(executor::lowestPriority).tasks);
+}
+
+// the Chase-Lev deque hands each element out exactly once, and the
+// work-stealing pool runs every task posted, follow-ups included
+TEST(deferredThreadScheduler, test_40)
+{
+  // the deque: LIFO for its owner, FIFO for the thieves, growing when full
+  {
+    workStealingDeque<int> d {4};
+    std::array<int, 1000> values {};
+
+    for (auto i {0}; i < 1000; ++i)
+    {
+      values[static_cast<std::size_t>(i)] = i;
+      d.push(&values[static_cast<std::size_t>(i)]);
+    }
+    ASSERT_EQ(1000u, d.size());
+    ASSERT_EQ(999, *d.pop());
+    ASSERT_EQ(0, *d.steal());
+    ASSERT_EQ(1, *d.steal());
+    ASSERT_EQ(998, *d.pop());
+    while ( nullptr != d.pop() )
+    {}
+    ASSERT_EQ(true, d.empty());
+    ASSERT_EQ(nullptr, d.steal());
+  }
+
+  // each element is taken exactly once by the owner or by a thief
+  {
+    constexpr int n {200000};
+    workStealingDeque<int> d {};
+    std::vector<int> values (n);
+    std::vector<std::atomic<int>> taken (n);
+    std::atomic<bool> done {false};
+    std::vector<std::thread> thieves {};
+
+    for (auto k {0}; k < 3; ++k)
+    {
+      thieves.emplace_back([&d, &values, &taken, &done] ()
+                           {
+                             while ( false == done.load() )
+                             {
+                               if ( auto x = d.steal();
+                                    nullptr != x )
+                               {
+                                 ++taken[static_cast<std::size_t>(x - values.data())];
+                               }
+                             }
+                           });
+    }
+    for (auto i {0}; i < n; ++i)
+    {
+      d.push(&values[static_cast<std::size_t>(i)]);
+      if ( 0 == i % 3 )
+      {
+        if ( auto x = d.pop();
+             nullptr != x )
+        {
+          ++taken[static_cast<std::size_t>(x - values.data())];
+        }
+      }
+    }
+    while ( auto x = d.pop() )
+    {
+      ++taken[static_cast<std::size_t>(x - values.data())];
+    }
+    done = true;
+    for (auto& t : thieves)
+    {
+      t.join();
+    }
+    ASSERT_EQ(true, std::all_of(taken.begin(), taken.end(), [] (const auto& t) { return 1 == t.load(); }));
+  }
+
+  // tasks posted from outside and follow-ups posted by the tasks themselves
+  {
+    constexpr int external {10000};
+    constexpr int depth {10};
+    std::atomic<int> runs {0};
+    {
+      auto wsp = std::make_unique<workStealingPool>(4);
+      // reset() nulls wsp before running the dtor
+      std::function<void(int)> fanOut = [pool = wsp.get(), &runs, &fanOut] (int d)
+                                        {
+                                          ++runs;
+                                          if ( d > 0 )
+                                          {
+                                            pool->post([&fanOut, d] () { fanOut(d - 1); });
+                                            pool->post([&fanOut, d] () { fanOut(d - 1); });
+                                          }
+                                        };
+
+      ASSERT_EQ(4u, wsp->numWorkers());
+      wsp->post([&fanOut] () { fanOut(depth); });
+      for (auto i {0}; i < external; ++i)
+      {
+        wsp->post([&runs] () { ++runs; });
+      }
+      // the dtor runs all the tasks posted, follow-ups included
+      wsp.reset();
+    }
+    ASSERT_EQ(external + (1 << (depth + 1)) - 1, runs.load());
+  }
+
+  // the executor of deferred tasks
+  {
+    using threadResultType = int;
+    using threadFun = std::function<threadResultType(int)>;
+    using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+    threadFun identity = [] (int i) { return i; };
+    workStealingPool wsp {2};
+    std::vector<std::unique_ptr<dtsType>> instances {};
+
+    for (auto i {0}; i < 200; ++i)
+    {
+      instances.push_back(std::make_unique<dtsType>("dts" + std::to_string(i), wsp));
+      instances.back()->registerThread(identity, i).runIn(std::chrono::milliseconds(i % 20));
+    }
+    ASSERT_EQ(200u, dtsType::wait_all(instances, 10s).size());
+    for (auto i {0}; i < 200; ++i)
+    {
+      ASSERT_EQ(i, std::get<1>(instances[static_cast<std::size_t>(i)]->wait()));
+    }
+  }
+}
+
+// the worker pools, the timer thread and the thread of an instance without a
+// timer service run on the CPUs they are pinned to
+TEST(deferredThreadScheduler, test_41)
+{
+#if defined(__linux__)
+  // every machine has cpu 0
+  const cpuSet cpu0 {0};
+
+  ASSERT_EQ(false, pinThisThread({}));
+  ASSERT_EQ(false, pinThisThread({4096}));
+
+  // the worker pools: each worker runs on the CPUs it is pinned to
+  {
+    std::atomic<int> cpu {-1};
+    {
+      workerPool wp {1, {cpu0}};
+
+      wp.post([&cpu] () { cpu = sched_getcpu(); });
+    }
+    ASSERT_EQ(0, cpu.load());
+  }
+  {
+    std::atomic<int> runs {0};
+    std::atomic<int> elsewhere {0};
+    {
+      workStealingPool wsp {2, {cpu0}};
+
+      for (auto i {0}; i < 100; ++i)
+      {
+        wsp.post([&runs, &elsewhere] ()
+                 {
+                   ++runs;
+                   if ( 0 != sched_getcpu() )
+                   {
+                     ++elsewhere;
+                   }
+                 });
+      }
+    }
+    ASSERT_EQ(100, runs.load());
+    ASSERT_EQ(0, elsewhere.load());
+  }
+
+  // the timer thread
+  {
+    timerService ts {};
+
+    ASSERT_EQ(true, ts.pinTimerThread(cpu0));
+  }
+
+  // the thread of an instance without a timer service
+  {
+    using threadResultType = int;
+    using threadFun = std::function<threadResultType()>;
+    using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+    threadFun whereAmI = [] () { return sched_getcpu(); };
+    dtsType dts {"dts"};
+
+    dts.setAffinity(cpu0).registerThread(whereAmI).runIn(10ms);
+    ASSERT_EQ(0, std::get<1>(dts.wait()));
+  }
+#endif
+}
+
+// a periodic task canceled between the end of a run and the next one is
+// never run again, whether it has a thread of its own or a timer service
+TEST(deferredThreadScheduler, test_42)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType(const stopToken&)>;
+
+  for (auto ts : {static_cast<timerService*>(nullptr), &timerService::defaultTimerService()})
+  {
+    for (auto i {0}; i < 200; ++i)
+    {
+      std::atomic<int> runs {0};
+      std::atomic<int> runsAfterStop {0};
+      deferredThreadScheduler<threadResultType, threadFun> dts {"gapbeat"};
+
+      if ( nullptr != ts )
+      {
+        dts.useTimerService(*ts);
+      }
+      dts.registerThread([&runs, &runsAfterStop](const stopToken& st) noexcept(false) -> threadResultType
+                         {
+                           if ( st.stopRequested() )
+                           {
+                             ++runsAfterStop;
+                           }
+                           return ++runs;
+                         }).runEvery(1ms);
+      while ( 0 == runs )
+      {
+        std::this_thread::yield();
+      }
+      ASSERT_EQ(true, dts.cancelThread());
+      auto [threadState, threadResult] = dts.wait();
+      ASSERT_EQ(dts.isCanceled(threadState), true);
+      ASSERT_EQ(0, runsAfterStop.load());
+      ASSERT_EQ(runs, dts.getExecutions());
+    }
+  }
+}
+
+// a task canceled while its timer is being armed leaves no timer behind, so
+// that it is destroyed at once instead of waiting for its deadline
+TEST(deferredThreadScheduler, test_43)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  threadFun zero = [] () { return 0; };
+  timerService ts {std::make_unique<dAryHeapTimerQueue>()};
+
+  for (auto i {0}; i < 200; ++i)
+  {
+    auto start = timerClock::now();
+    {
+      dtsType dts {"armed"};
+
+      dts.useTimerService(ts).registerThread(zero);
+      std::thread canceler([&dts] ()
+                           {
+                             while ( false == dts.isScheduled() )
+                             {}
+                             dts.cancelThread();
+                           });
+      dts.runIn(3600s);
+      canceler.join();
+      ASSERT_EQ(true, dts.isCanceled());
+      ASSERT_EQ(0u, ts.pendingTimers());
+    }
+    ASSERT_EQ(true, timerClock::now() - start < 10s);
+  }
+}
+
+// a task graph whose deadline cannot be armed cancels the node and its
+// dependents instead of waiting forever, and a graph not started is not
+// waited for
+TEST(deferredThreadScheduler, test_44)
+{
+  using nodeState = taskGraph::nodeState;
+  // a timer queue out of memory
+  class fullTimerQueue final : public timerQueue
+  {
+   public:
+    void
+    push(const slotIndex, const timerDeadline) noexcept(false) override
+    {
+      throw std::bad_alloc();
+    }
+    void
+    erase(const slotIndex, const timerDeadline) noexcept override
+    {}
+    timerDeadline
+    nextDeadline() const noexcept override
+    {
+      return {};
+    }
+    void
+    popExpired(const timerDeadline, std::vector<slotIndex>&) noexcept(false) override
+    {}
+    std::size_t
+    size() const noexcept override
+    {
+      return 0;
+    }
+  };
+  workerPool wp {2};
+  timerService ts {std::make_unique<fullTimerQueue>(), wp};
+
+  {
+    taskGraph g {ts};
+    std::atomic<int> runs {0};
+    auto a = g.addNode([&runs] () { ++runs; }, timerClock::now() + 10ms);
+    auto b = g.addNode([&runs] () { ++runs; });
+    auto c = g.addNode([&runs] () { ++runs; });
+    g.addDependency(a, b);
+    ASSERT_EQ(true, g.start());
+    g.wait();
+    ASSERT_EQ(nodeState::Canceled, g.getNodeState(a));
+    ASSERT_EQ(nodeState::Canceled, g.getNodeState(b));
+    ASSERT_EQ(nodeState::Run, g.getNodeState(c));
+    ASSERT_EQ(1, runs.load());
+  }
+
+  {
+    taskGraph g {ts};
+    auto a = g.addNode([] () {});
+    g.wait();
+    ASSERT_EQ(nodeState::Pending, g.getNodeState(a));
+  }
+}
+
+// a thread waits on an instance served by a timer service while another
+// cancels it: the wait returns Canceled, not a broken promise
+TEST(deferredThreadScheduler, test_45)
+{
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  using dtsType = deferredThreadScheduler<threadResultType, threadFun>;
+  using threadState = deferredThreadSchedulerBase::threadState;
+  timerService ts {};
+  dtsType dts {"canceled while waited"};
+
+  dts.useTimerService(ts).registerThread([] () { return 42; }).runIn(3600s);
+  auto waiter {std::async(std::launch::async, [&dts] () { return dts.wait(); })};
+
+  // the waiter blocks on the run before the cancel
+  ASSERT_EQ(std::future_status::timeout, waiter.wait_for(50ms));
+  ASSERT_EQ(true, dts.cancelThread());
+  auto [threadState_, threadResult] = waiter.get();
+  ASSERT_EQ(static_cast<int>(threadState::Canceled), threadState_);
+  ASSERT_EQ(0, threadResult);
+  ASSERT_EQ(true, dts.isCanceled());
+  ASSERT_EQ("", dts.getExceptionThrownMessage());
+  ASSERT_EQ(0, ts.pendingTimers());
+}
+
+// nodes canceled while start() arms their deadlines leave no timer armed:
+// wait() does not wait for the far deadlines
+TEST(deferredThreadScheduler, test_46)
+{
+  using nodeState = taskGraph::nodeState;
+  workerPool wp {2};
+  timerService ts {std::make_unique<dAryHeapTimerQueue>(), wp};
+  const std::size_t numNodes {64};
+
+  for (auto i {0}; i < 200; ++i)
+  {
+    taskGraph g {ts};
+    std::atomic<bool> go {false};
+
+    for (std::size_t n {}; n < numNodes; ++n)
+    {
+      g.addNode([] () {}, timerClock::now() + 3600s);
+    }
+    auto canceler {std::async(std::launch::async,
+                              [&g, &go, numNodes] ()
+                              {
+                                while ( false == go.load() )
+                                {
+                                  std::this_thread::yield();
+                                }
+                                for (auto id {numNodes}; id > 0; --id)
+                                {
+                                  g.cancel(id - 1);
+                                }
+                              })};
+    go = true;
+    ASSERT_EQ(true, g.start());
+    canceler.get();
+    g.wait();
+    for (std::size_t n {}; n < numNodes; ++n)
+    {
+      ASSERT_EQ(nodeState::Canceled, g.getNodeState(n));
+    }
+    ASSERT_EQ(0u, ts.pendingTimers());
+  }
+}
+
+// a timing wheel with a tiny tick jumps over the empty rotations to its next
+// timer, far as it may be, instead of walking through them
+TEST(deferredThreadScheduler, test_47)
+{
+  auto origin = timerClock::now();
+  timingWheelTimerQueue twq {1ns, origin};
+  std::vector<timerQueue::slotIndex> expired {};
+  // deadlines in level 3 and in the overflow list of a 1ns wheel
+  const std::vector<std::chrono::nanoseconds> delays {50ms, 1s, 3'600s, 86'400s};
+  auto start = timerClock::now();
+
+  for (std::size_t i {}; i < delays.size(); ++i)
+  {
+    twq.push(static_cast<timerQueue::slotIndex>(i), origin + delays[i]);
+  }
+  for (std::size_t i {}; i < delays.size(); ++i)
+  {
+    ASSERT_EQ(true, twq.nextDeadline() <= origin + delays[i]);
+    twq.popExpired(origin + delays[i] - 1ns, expired);
+    ASSERT_EQ(i, expired.size());
+    twq.popExpired(origin + delays[i], expired);
+    ASSERT_EQ(i + 1, expired.size());
+    ASSERT_EQ(static_cast<timerQueue::slotIndex>(i), expired.back());
+  }
+  ASSERT_EQ(true, twq.empty());
+  ASSERT_EQ(true, timerClock::now() - start < 1s);
+
+  // a timer service firing through such a wheel, with a far timer pending
+  using threadResultType = int;
+  using threadFun = std::function<threadResultType()>;
+  timerService ts {std::make_unique<timingWheelTimerQueue>(1ns)};
+  deferredThreadScheduler<threadResultType, threadFun> dtsFar {"far"};
+  deferredThreadScheduler<threadResultType, threadFun> dtsNear {"near"};
+
+  dtsFar.registerThread([] () { return 1; }).useTimerService(ts).runIn(3'600s);
+  dtsNear.registerThread([] () { return 2; }).useTimerService(ts).runIn(100ms);
+  auto [threadState, threadResult] = dtsNear.wait();
+  ASSERT_EQ(dtsNear.isRun(threadState), true);
+  ASSERT_EQ(2, threadResult);
+  ASSERT_EQ(true, dtsFar.cancelThread());
+  ASSERT_EQ(0, ts.pendingTimers());
+}
+
+// the flags set by many threads are spread over the shards of the registry,
+// although the ids of the threads are aligned addresses
+TEST(deferredThreadScheduler, test_48)
+{
+  cancellationFlagsRegistry cfr {};
+  std::vector<std::thread> threads {};
+  std::atomic<int> flagsSet {0};
+  std::atomic<bool> done {false};
+  const int numThreads {32};
+
+  // the threads stay alive until all the flags are set: their ids differ
+  for (int i {}; i < numThreads; ++i)
+  {
+    threads.emplace_back([&cfr, &flagsSet, &done] ()
+                         {
+                           if ( cfr.set(std::this_thread::get_id()) )
+                           {
+                             ++flagsSet;
+                           }
+                           while ( false == done.load() )
+                           {
+                             std::this_thread::yield();
+                           }
+                         });
+  }
+  while ( numThreads != flagsSet.load() )
+  {
+    std::this_thread::yield();
+  }
+  auto shardsInUse {cfr.shardsInUse()};
+  done = true;
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  ASSERT_EQ(static_cast<std::size_t>(numThreads), cfr.snapshot().size());
+  ASSERT_LT(1u, shardsInUse);
+
+  // hashes that are page aligned addresses, as the pthread_t of the threads
+  std::set<std::size_t> shards {};
+  for (std::size_t i {1}; i <= numThreads; ++i)
+  {
+    shards.insert(cancellationFlagsRegistry::shardIndex(i * 0x1000));
+  }
+  ASSERT_LT(static_cast<std::size_t>(numThreads) / 2, shards.size());
+}
+
+// a timer queue failing to collect its expired timers is retried after a
+// while, not in a busy loop
+TEST(deferredThreadScheduler, test_49)
+{
+  // a timer queue out of memory when its timers expire
+  class failingTimerQueue final : public timerQueue
+  {
+   public:
+    std::atomic<int> pops {0};
+
+    void
+    push(const slotIndex, const timerDeadline deadline) noexcept(false) override
+    {
+      deadline_ = deadline;
+      size_ = 1;
+    }
+    void
+    erase(const slotIndex, const timerDeadline) noexcept override
+    {
+      size_ = 0;
+    }
+    timerDeadline
+    nextDeadline() const noexcept override
+    {
+      return deadline_;
+    }
+    void
+    popExpired(const timerDeadline, std::vector<slotIndex>&) noexcept(false) override
+    {
+      ++pops;
+      throw std::bad_alloc();
+    }
+    std::size_t
+    size() const noexcept override
+    {
+      return size_;
+    }
+
+   private:
+    timerDeadline deadline_ {};
+    std::size_t size_ {0};
+  };
+  auto queue {std::make_unique<failingTimerQueue>()};
+  auto& failing {*queue};
+  timerService ts {std::move(queue)};
+
+  ts.schedule(timerClock::now(), [] () {});
+  std::this_thread::sleep_for(100ms);
+  ASSERT_LE(2, failing.pops.load());
+  ASSERT_GE(20, failing.pops.load());
+}
+
 TEST(deferredThreadScheduler,last_test)
 {
   auto [cfSize, cfSet, cfUnset] = deferredThreadSchedulerBase::listCancellationFlags(std::cout);
@@ -0,0 +1,195 @@
+/*
+ * File:   workStealingDeque.h
+ * Author: massimo
+ *
+ * Created on October 17, 2026, 11:30 PM
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+////////////////////////////////////////////////////////////////////////////////
+// BEGIN: ignore the warnings listed below when compiled with clang from here
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+////////////////////////////////////////////////////////////////////////////////
+namespace DTS
+{
+// The Chase-Lev work-stealing deque of pointers to T: its owner thread pushes
+// and pops at the bottom, last in first out, without any read-modify-write
+// unless a single element is left, while any other thread steals from the top,
+// first in first out, with one compare-and-swap.
+// The ring grows when full; the rings outgrown are kept until the deque is
+// destroyed, since a thief may still read from them. The deque does not own
+// the elements left in it.
+template <typename T>
+class workStealingDeque final
+{
+ public:
+  workStealingDeque(const workStealingDeque& rhs) = delete;
+  workStealingDeque& operator=(const workStealingDeque& rhs) = delete;
+  workStealingDeque(workStealingDeque&& rhs) = delete;
+  workStealingDeque& operator=(workStealingDeque&& rhs) = delete;
+
+  // capacity is rounded up to a power of two
+  explicit
+  workStealingDeque(const std::size_t capacity = 256) noexcept(false)
+  {
+    std::size_t c {2};
+    while ( c < capacity )
+    {
+      c *= 2;
+    }
+    rings_.push_back(std::make_unique<ring>(static_cast<std::int64_t>(c)));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+  }
+
+  ~workStealingDeque() noexcept = default;
+
+  // owner only
+  void
+  push(T* x) noexcept(false)
+  {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_acquire);
+    auto r = ring_.load(std::memory_order_relaxed);
+
+    if ( b - t > r->capacity - 1 )
+    {
+      r = grow(r, t, b);
+    }
+    r->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // owner only: the element pushed last, or nullptr if empty
+  T*
+  pop() noexcept
+  {
+    auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    auto r = ring_.load(std::memory_order_relaxed);
+
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto t = top_.load(std::memory_order_relaxed);
+    if ( t > b )
+    {
+      // empty
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    auto x = r->get(b);
+    if ( t == b )
+    {
+      // the last element: race the thieves for it
+      if ( false == top_.compare_exchange_strong(t,
+                                                t + 1,
+                                                std::memory_order_seq_cst,
+                                                std::memory_order_relaxed) )
+      {
+        x = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // any thread: the oldest element, or nullptr if empty or if another thread
+  // took it first
+  T*
+  steal() noexcept
+  {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+
+    if ( t >= b )
+    {
+      return nullptr;
+    }
+
+    auto x = ring_.load(std::memory_order_acquire)->get(t);
+    if ( false == top_.compare_exchange_strong(t,
+                                              t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed) )
+    {
+      return nullptr;
+    }
+    return x;
+  }
+
+  // a snapshot, exact only when no other thread uses the deque
+  std::size_t
+  size() const noexcept
+  {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_relaxed);
+
+    return (b > t) ? static_cast<std::size_t>(b - t) : 0;
+  }
+
+  bool
+  empty() const noexcept
+  {
+    return 0 == size();
+  }
+
+ private:
+  struct ring
+  {
+    std::int64_t capacity;
+    std::unique_ptr<std::atomic<T*>[]> slots;
+
+    explicit
+    ring(const std::int64_t c) noexcept(false)
+    :
+    capacity (c),
+    slots (std::make_unique<std::atomic<T*>[]>(static_cast<std::size_t>(c)))
+    {}
+
+    T*
+    get(const std::int64_t i) const noexcept
+    {
+      return slots[static_cast<std::size_t>(i & (capacity - 1))].load(std::memory_order_relaxed);
+    }
+
+    void
+    put(const std::int64_t i, T* x) noexcept
+    {
+      slots[static_cast<std::size_t>(i & (capacity - 1))].store(x, std::memory_order_relaxed);
+    }
+  };
+
+  // top_ is only incremented, by the thieves and by the owner taking the last
+  // element; bottom_ is written by the owner only
+  std::atomic<std::int64_t> top_ {0};
+  std::atomic<std::int64_t> bottom_ {0};
+  std::atomic<ring*> ring_ {nullptr};
+  // owner only
+  std::vector<std::unique_ptr<ring>> rings_ {};
+
+  ring*
+  grow(const ring* r, const std::int64_t t, const std::int64_t b) noexcept(false)
+  {
+    rings_.push_back(std::make_unique<ring>(r->capacity * 2));
+
+    auto bigger = rings_.back().get();
+    for (auto i {t}; i < b; ++i)
+    {
+      bigger->put(i, r->get(i));
+    }
+    ring_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+};  // class workStealingDeque
+}  // namespace DTS
+////////////////////////////////////////////////////////////////////////////////
+#pragma clang diagnostic pop
+// END: ignore the warnings when compiled with clang up to here